@@ -0,0 +1,204 @@
+#include <chrono>
+#include "doctest.h"
+#include "diagnostics/univariate_psrf.hpp"
+#include "Eigen/Eigen"
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "known_polytope_generators.h"
+#include "misc.h"
+#include "random.hpp"
+#include "random/uniform_int.hpp"
+#include "random/normal_distribution.hpp"
+#include "random/uniform_real_distribution.hpp"
+#include "random_walks/random_walks.hpp"
+#include <vector>
+
+
+// Boundary oracle of an H-polytope for B chains at once. The chains are the
+// columns of X (d x B) and AX (m x B) caches A*X. For the directions in the
+// columns of V the product A*V is computed as one matrix-matrix product, so A
+// is streamed from memory once per step for all the chains. The masked
+// column-wise reductions below are vectorized by Eigen (compile with
+// -mavx2 or -mavx512f to get the wide kernels).
+template <typename MT, typename VT>
+void batch_line_intersect(MT const& A,
+                          VT const& b,
+                          MT const& AX,
+                          MT const& V,
+                          MT &AV,
+                          VT &lambdas_plus,
+                          VT &lambdas_minus)
+{
+    typedef typename MT::Scalar NT;
+    const NT inf = std::numeric_limits<NT>::max();
+
+    AV.noalias() = A * V;
+    MT ratios = ((-AX).colwise() + b).cwiseQuotient(AV);
+
+    lambdas_plus = (AV.array() > NT(0)).select(ratios.array(), inf)
+                       .colwise().minCoeff().transpose();
+    lambdas_minus = (AV.array() < NT(0)).select(ratios.array(), -inf)
+                       .colwise().maxCoeff().transpose();
+}
+
+
+// Random directions hit-and-run for B chains that share one H-polytope. A*X
+// is updated with the moves and recomputed every refresh_period steps, so the
+// rounding errors of the updates do not build up along the chains.
+template <typename Polytope, typename RandomNumberGenerator>
+struct BatchRDHRWalk
+{
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+
+    BatchRDHRWalk(Polytope const& P,
+                  MT const& X0,
+                  unsigned int const& refresh_period = 64)
+        : _A(P.get_mat()), _b(P.get_vec()), _refresh_period(refresh_period),
+          _steps(0), X(X0)
+    {
+        _AX.noalias() = _A * X;
+    }
+
+    void apply(unsigned int const& walk_length,
+               RandomNumberGenerator &rng)
+    {
+        unsigned int d = X.rows(), B = X.cols();
+        MT V(d, B), AV;
+        VT lambdas_plus, lambdas_minus, t(B);
+
+        for (unsigned int j = 0u; j < walk_length; ++j)
+        {
+            for (unsigned int k = 0; k < B; k++)
+            {
+                for (unsigned int i = 0; i < d; i++)
+                {
+                    V(i, k) = rng.sample_ndist();
+                }
+            }
+            V.colwise().normalize();
+
+            batch_line_intersect(_A, _b, _AX, V, AV, lambdas_plus, lambdas_minus);
+
+            for (unsigned int k = 0; k < B; k++)
+            {
+                t(k) = lambdas_minus(k) + rng.sample_urdist()
+                       * (lambdas_plus(k) - lambdas_minus(k));
+            }
+            X.noalias() += V * t.asDiagonal();
+
+            if (++_steps % _refresh_period == 0)
+            {
+                _AX.noalias() = _A * X;
+            }
+            else
+            {
+                _AX.noalias() += AV * t.asDiagonal();
+            }
+        }
+    }
+
+    MT _A;
+    VT _b;
+    MT _AX;
+    unsigned int _refresh_period;
+    unsigned long _steps;
+    MT X;
+};
+
+
+template <typename NT>
+void call_test_batch_line_intersect(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 10, B = 16;
+
+    std::cout << "--- Testing batch boundary oracle on H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    RNGType rng(d);
+
+    MT X(d, B), V(d, B), AV;
+    VT lambdas_plus, lambdas_minus;
+    for (unsigned int k = 0; k < B; k++)
+    {
+        for (unsigned int i = 0; i < d; i++)
+        {
+            X(i, k) = NT(0.5) * (NT(2) * rng.sample_urdist() - NT(1));
+            V(i, k) = rng.sample_ndist();
+        }
+    }
+    V.colwise().normalize();
+    MT AX = P.get_mat() * X;
+
+    batch_line_intersect(P.get_mat(), P.get_vec(), AX, V, AV, lambdas_plus, lambdas_minus);
+
+    for (unsigned int k = 0; k < B; k++)
+    {
+        Point r(d), v(d);
+        r.set_coeffs(X.col(k));
+        v.set_coeffs(V.col(k));
+        std::pair<NT, NT> bpair = P.line_intersect(r, v);
+
+        CHECK(std::abs(bpair.first - lambdas_plus(k)) < 1e-10);
+        CHECK(std::abs(bpair.second - lambdas_minus(k)) < 1e-10);
+    }
+}
+
+template <typename NT>
+void call_test_batch_rdhr(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 10, B = 8, walkL = 10, chain_length = 1250;
+
+    std::cout << "--- Testing batch RDHR (8 chains) on H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    RNGType rng(d);
+
+    BatchRDHRWalk<Hpolytope, RNGType> walk(P, MT::Zero(d, B));
+    MT samples(d, B * chain_length);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < chain_length; i++)
+    {
+        walk.apply(walkL, rng);
+        for (unsigned int k = 0; k < B; k++)
+        {
+            samples.col(k * chain_length + i) = walk.X.col(k);
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    long ETA = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+    std::cout << "ETA (us): " << ETA << std::endl;
+
+    VT score = univariate_psrf<NT, VT>(samples);
+    std::cout << "psrf = " << score.maxCoeff() << std::endl;
+
+    MT AX = P.get_mat() * walk.X;
+    std::cout << "max |AX - A*X| = " << (walk._AX - AX).cwiseAbs().maxCoeff() << std::endl;
+
+    CHECK(score.maxCoeff() < 1.1);
+    CHECK((P.get_mat() * samples).colwise().maxCoeff().maxCoeff() <= NT(1) + 1e-10);
+    CHECK((walk._AX - AX).cwiseAbs().maxCoeff() < 1e-12);
+}
+
+
+TEST_CASE("batch_line_intersect") {
+    call_test_batch_line_intersect<double>();
+}
+
+TEST_CASE("batch_rdhr") {
+    call_test_batch_rdhr<double>();
+}
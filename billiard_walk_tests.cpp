@@ -8,6 +8,7 @@
 #include "diagnostics/raftery.hpp"
 #include <fstream>
 #include <iostream>
+#include <vector>
 #include "misc.h"
 #include "random.hpp"
 #include "random/uniform_int.hpp"
@@ -27,27 +28,56 @@ template
     typename WalkType,
     typename Polytope
 >
-MT get_samples(Polytope &P)
+MT get_samples(Polytope &P, unsigned int num_chains = 1)
 {
     typedef typename Polytope::PointType Point;
     typedef typename Polytope::NT NT;
+    typedef typename Polytope::VT VT;
 
     typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+    typedef typename WalkType::template Walk<Polytope, RNGType> Walk;
 
-    unsigned int walkL = 10, numpoints = 10000, nburns = 0, d = P.dimension();
+    unsigned int walkL = 10, numpoints = 10000, d = P.dimension();
+    // every chain gets the same length, so numpoints is rounded up
+    unsigned int chain_length = (numpoints + num_chains - 1) / num_chains;
     RNGType rng(d);
-    Point StartingPoint(d);
-    std::list<Point> randPoints;
 
-    uniform_sampling<WalkType>(randPoints, P, rng, walkL, numpoints,
-                               StartingPoint, nburns);
+    // the first chain starts at the origin, the others at a random fraction
+    // of the chord from the origin along a random direction, so the chains
+    // are overdispersed as the psrf assumes
+    std::vector<Point> chain_points(num_chains, Point(d));
+    for (unsigned int k = 1; k < num_chains; k++)
+    {
+        VT direction(d);
+        for (unsigned int j = 0; j < d; j++)
+        {
+            direction(j) = rng.sample_ndist();
+        }
+        direction.normalize();
+        Point v(d);
+        v.set_coeffs(direction);
+        NT lambda = P.line_intersect(chain_points[k], v).first;
+        chain_points[k].set_coeffs(NT(0.9) * rng.sample_urdist() * lambda * direction);
+    }
+
+    std::vector<Walk> walks;
+    walks.reserve(num_chains);
+    for (unsigned int k = 0; k < num_chains; k++)
+    {
+        walks.emplace_back(P, chain_points[k], rng);
+    }
 
-    MT samples(d, numpoints);
-    unsigned int jj = 0;
+    // The chains advance in lockstep and each one writes its points straight
+    // into its own block of columns, so there is no intermediate point list
+    MT samples(d, num_chains * chain_length);
 
-    for (typename std::list<Point>::iterator rpit = randPoints.begin(); rpit!=randPoints.end(); rpit++, jj++)
+    for (unsigned int i = 0; i < chain_length; i++)
     {
-        samples.col(jj) = (*rpit).getCoefficients();
+        for (unsigned int k = 0; k < num_chains; k++)
+        {
+            walks[k].apply(P, chain_points[k], walkL, rng);
+            samples.col(k * chain_length + i) = chain_points[k].getCoefficients();
+        }
     }
 
     return samples;
@@ -97,6 +127,39 @@ void call_test_univariate_psrf(){
     CHECK(score.maxCoeff() < 1.1);
 }
 
+template <typename NT>
+void call_test_univariate_psrf_chains(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    Hpolytope P;
+    unsigned int d = 10, num_chains = 3;
+
+    std::cout << "--- Testing univariate psrf of 3 chains on Billiard Walk and H-cube10" << std::endl;
+    P = generate_cube<Hpolytope>(d, false);
+    P.ComputeInnerBall();
+
+    // 10000 is not a multiple of 3, the chains are rounded up to 3334 points
+    MT samples = get_samples<MT, AcceleratedBilliardWalk>(P, num_chains);
+    CHECK(samples.cols() == 3 * 3334);
+
+    VT score = univariate_psrf<NT, VT>(samples);
+
+    std::cout<<"univariate psrf = "<<score.transpose()<<std::endl;
+    CHECK(score.maxCoeff() < 1.1);
+
+    std::cout << "--- Testing univariate psrf of 4 chains on Billiard Walk and H-cube10" << std::endl;
+    samples = get_samples<MT, AcceleratedBilliardWalk>(P, 4);
+    CHECK(samples.cols() == 10000);
+
+    score = univariate_psrf<NT, VT>(samples);
+
+    std::cout<<"univariate psrf = "<<score.transpose()<<std::endl;
+    CHECK(score.maxCoeff() < 1.1);
+}
+
 template <typename NT>
 void call_test_interval_psrf(){
     typedef Cartesian<NT>    Kernel;
@@ -200,6 +263,10 @@ TEST_CASE("univariate_psrf") {
     call_test_univariate_psrf<double>();
 }
 
+TEST_CASE("univariate_psrf_chains") {
+    call_test_univariate_psrf_chains<double>();
+}
+
 TEST_CASE("interval_psrf") {
     call_test_interval_psrf<double>();
 }
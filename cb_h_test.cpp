@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <chrono>
 #include "doctest.h"
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <tuple>
 #include "known_polytope_generators.h"
 #include "misc.h"
 #include "random.hpp"
@@ -8,6 +12,7 @@
 #include "random/normal_distribution.hpp"
 #include "random/uniform_real_distribution.hpp"
 #include "random_walks/random_walks.hpp"
+#include <boost/math/distributions/students_t.hpp>
 #include "volume/volume_sequence_of_balls.hpp"
 #include "volume/volume_cooling_gaussians.hpp"
 #include "volume/volume_cooling_balls.hpp"
@@ -67,6 +72,74 @@ void test_volume(Polytope &HP,
     test_values(volume, expectedBilliard, exact);
 }
 
+// Anytime cooling balls: runs independent volume estimations with error e_batch
+// one after the other and after each one calls callback(n, estimate, lower, upper)
+// with the running estimate and its confidence interval. The interval is computed
+// on the log-volumes with the Student-t quantile of n - 1 degrees of freedom, and
+// the estimate exp(mean log-volume) is their geometric mean, which is biased low
+// by about half the variance of one log-volume (the bias shrinks as e_batch does).
+// The estimation stops when the callback returns false, when at least
+// min_estimates estimations are done and the relative half-width of the interval
+// drops below rel_tolerance, or when the deadline is reached. Returns the final
+// (estimate, lower, upper).
+// The deadline is checked between estimations, since volume_cooling_balls cannot
+// be interrupted inside its phases. A new estimation is started only if it is
+// expected to end in time, i.e. if the longest one so far fits before the
+// deadline, so the deadline is overrun at most by the first estimation or by the
+// excess of one estimation over the longest previous one.
+template
+<
+    typename WalkType,
+    typename RNGType,
+    typename Polytope,
+    typename Callback
+>
+std::tuple<double, double, double> volume_cooling_balls_anytime(Polytope &P,
+                                                                double const& e_batch,
+                                                                unsigned int const& walk_len,
+                                                                double const& rel_tolerance,
+                                                                std::chrono::steady_clock::time_point const& deadline,
+                                                                Callback callback,
+                                                                double const& confidence = 0.95,
+                                                                unsigned int const& min_estimates = 5)
+{
+    RNGType rng(P.dimension());
+    unsigned int n = 0;
+    double mean = 0.0, M2 = 0.0, delta, half_width = 0.0;
+    double estimate = 0.0, lower = 0.0, upper = std::numeric_limits<double>::infinity();
+
+    std::chrono::steady_clock::duration longest_batch(0);
+
+    while (true)
+    {
+        auto batch_start = std::chrono::steady_clock::now();
+        double log_volume = std::log(volume_cooling_balls<WalkType>(P, rng, e_batch, walk_len).second);
+        longest_batch = std::max(longest_batch, std::chrono::steady_clock::now() - batch_start);
+
+        // Welford update of the mean and variance of the log-volumes
+        n++;
+        delta = log_volume - mean;
+        mean += delta / n;
+        M2 += delta * (log_volume - mean);
+
+        estimate = std::exp(mean);
+        if (n > 1)
+        {
+            boost::math::students_t t_dist(double(n - 1));
+            double t = boost::math::quantile(boost::math::complement(t_dist, (1.0 - confidence) / 2.0));
+            half_width = t * std::sqrt(M2 / (n - 1) / n);
+            lower = std::exp(mean - half_width);
+            upper = std::exp(mean + half_width);
+        }
+
+        if (!callback(n, estimate, lower, upper)) break;
+        if (n >= std::max(2u, min_estimates) && std::exp(half_width) - 1.0 < rel_tolerance) break;
+        if (std::chrono::steady_clock::now() + longest_batch > deadline) break;
+    }
+
+    return std::make_tuple(estimate, lower, upper);
+}
+
 template <typename NT>
 void call_test_cube(){
     typedef Cartesian<NT>    Kernel;
@@ -100,6 +173,50 @@ void call_test_cube_float(){
     */
 }
 
+template <typename NT>
+void call_test_cube_anytime(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    std::cout << "--- Testing anytime volume of H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(10, false);
+
+    unsigned int num_batches = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    auto callback = [&num_batches](unsigned int n, double estimate, double lower, double upper) {
+        std::cout << "batch " << n << ": " << estimate
+                  << " [" << lower << ", " << upper << "]" << std::endl;
+        num_batches = n;
+        return true;
+    };
+
+    std::tuple<double, double, double> res =
+        volume_cooling_balls_anytime<CDHRWalk, RNGType>(P, 0.2, 11, 0.05, deadline, callback);
+
+    CHECK(num_batches >= 5);
+    CHECK(std::get<1>(res) <= std::get<0>(res));
+    CHECK(std::get<0>(res) <= std::get<2>(res));
+    test_values(NT(std::get<0>(res)), NT(1024), NT(1024));
+
+    // with no tolerance only the deadline stops the estimation, and it is
+    // overrun by less than the longest estimation
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration longest_batch(0);
+    auto timing_callback = [&](unsigned int n, double estimate, double lower, double upper) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        longest_batch = std::max(longest_batch, now - last);
+        last = now;
+        num_batches = n;
+        return true;
+    };
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    volume_cooling_balls_anytime<CDHRWalk, RNGType>(P, 0.2, 11, 0.0, deadline, timing_callback);
+    std::cout << "batches before the deadline: " << num_batches << std::endl;
+    CHECK(std::chrono::steady_clock::now() <= deadline + longest_batch);
+}
+
 template <typename NT>
 void call_test_cross(){
     typedef Cartesian<NT>    Kernel;
@@ -255,6 +372,10 @@ TEST_CASE("cube") {
     call_test_cube_float<float>();
 }
 
+TEST_CASE("cube_anytime") {
+    call_test_cube_anytime<double>();
+}
+
 TEST_CASE("cross") {
     call_test_cross<double>();
 }
@@ -2,6 +2,8 @@
 #include <vector>
 #include "cartesian_geom/cartesian_kernel.h"
 #include "hpolytope.h"
+#include "orderpolytope.h"
+#include "poset.h"
 #include "known_polytope_generators.h"
 
 #include "random_walks/random_walks.hpp"
@@ -14,9 +16,14 @@
 #include "preprocess/min_sampling_covering_ellipsoid_rounding.hpp"
 #include "preprocess/svd_rounding.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 #include "misc.h"
 
 
@@ -37,16 +44,27 @@ typedef Cartesian <NT> Kernel;
 typedef typename Kernel::Point Point;
 typedef BoostRandomNumberGenerator<boost::mt19937, NT, 5> RNGType;
 typedef HPolytope <Point> HPOLYTOPE;
+typedef OrderPolytope <Point> ORDERPOLYTOPE;
 typedef typename HPOLYTOPE::MT MT;
 typedef typename HPOLYTOPE::VT VT;
+typedef std::vector<std::pair<unsigned int, unsigned int>> RELATIONS;
 
 struct ArgOptions {
     VOL_OPTIONS vo;
     ROUND_OPTIONS ro;
     bool with_rounding;
-    HPOLYTOPE* HP;
-
-    NT volume_method (HPOLYTOPE& P,
+    unsigned int n_threads = 1;
+    // the order polytope oracles cost O(n + |relations|) per call, the dense
+    // H-polytope ones O((2n + |relations|) * n)
+    bool dense = false;
+    HPOLYTOPE* HP = NULL;
+    ORDERPOLYTOPE* OP = NULL;
+    // the cover relations a<b of the poset on n elements
+    unsigned int n = 0;
+    RELATIONS relations;
+
+    template <typename Polytope>
+    NT volume_method (Polytope& P,
                       NT e,
                       const unsigned int& walk_len) {
         switch (vo) {
@@ -55,13 +73,49 @@ struct ArgOptions {
             case CG:
                 return volume_cooling_gaussians<GaussianCDHRWalk, RNGType>(P, e, walk_len);
             case CB:
+                if (n_threads > 1) {
+                    return volume_cooling_balls_parallel(P, e, 2*walk_len);
+                }
                 return volume_cooling_balls<CDHRWalk, RNGType>(P, e, 2*walk_len).second;;
         }
 
         return -1;
     }
 
-    std::tuple<MT, VT, NT> rounding_method (HPOLYTOPE& P,
+    // Runs n_threads independent cooling balls estimations, each one on its own copy
+    // of P and with its own rng stream. Every estimation uses error e*sqrt(n_threads),
+    // so the mean of the n_threads estimates has relative error e. The error of one
+    // estimation is capped at max_thread_e, beyond that more threads only make the
+    // mean more accurate than e.
+    template <typename Polytope>
+    NT volume_cooling_balls_parallel (Polytope& P,
+                                      NT e,
+                                      const unsigned int& walk_len) {
+        const NT max_thread_e = 0.3;
+        std::vector<NT> volumes(n_threads, NT(0));
+        std::vector<std::thread> threads;
+        NT thread_e = std::min(e * std::sqrt(NT(n_threads)), std::max(e, max_thread_e));
+
+        for (unsigned int i = 0; i < n_threads; i++) {
+            threads.emplace_back([&P, &volumes, thread_e, walk_len, i]() {
+                Polytope Pi(P);
+                RNGType rng(Pi.dimension());
+                // the seed depends only on the index of the estimation
+                rng.set_seed(Pi.dimension() + i);
+                volumes[i] = volume_cooling_balls<CDHRWalk>(Pi, rng, thread_e, walk_len).second;
+            });
+        }
+
+        NT volume = NT(0);
+        for (unsigned int i = 0; i < n_threads; i++) {
+            threads[i].join();
+            volume += volumes[i];
+        }
+        return volume / NT(n_threads);
+    }
+
+    template <typename Polytope>
+    std::tuple<MT, VT, NT> rounding_method (Polytope& P,
                                             std::pair<Point, NT>& InnerBall,
                                             const unsigned int& walk_len,
                                             RNGType& rng) {
@@ -74,37 +128,204 @@ struct ArgOptions {
     }
 };
 
-NT calculateLinearExtension(ArgOptions& args) {
+
+// Kahn's algorithm on the relations a<=b of a poset. Returns false if the
+// relations have a cycle, i.e. they do not define a partial order.
+bool topological_order(unsigned int n,
+                       RELATIONS const& edges,
+                       std::vector<unsigned int>& order) {
+    std::vector<std::vector<unsigned int>> children(n);
+    std::vector<unsigned int> indegree(n, 0);
+    for (auto const& edge : edges) {
+        children[edge.first].push_back(edge.second);
+        indegree[edge.second]++;
+    }
+
+    order.clear();
+    for (unsigned int u = 0; u < n; ++u) {
+        if (indegree[u] == 0) order.push_back(u);
+    }
+    for (unsigned int i = 0; i < order.size(); ++i) {
+        for (unsigned int v : children[order[i]]) {
+            if (--indegree[v] == 0) order.push_back(v);
+        }
+    }
+    return order.size() == n;
+}
+
+
+// Keeps only the cover relations a<b, i.e. the ones with no c such that a<c<b.
+// Reflexive and repeated relations are dropped. The descendants of every element
+// are stored as bitsets and filled in reverse topological order, so the cost is
+// O(n * |relations| / 64) time and n^2/8 bytes. Returns false on a cycle.
+bool transitive_reduction(unsigned int n, RELATIONS& edges) {
+    std::vector<std::vector<unsigned int>> children(n);
+    for (auto const& edge : edges) {
+        if (edge.first != edge.second) children[edge.first].push_back(edge.second);
+    }
+    edges.clear();
+    for (unsigned int u = 0; u < n; ++u) {
+        std::sort(children[u].begin(), children[u].end());
+        children[u].erase(std::unique(children[u].begin(), children[u].end()), children[u].end());
+        for (unsigned int v : children[u]) edges.emplace_back(u, v);
+    }
+
+    std::vector<unsigned int> order;
+    if (!topological_order(n, edges, order)) return false;
+
+    unsigned int words = (n + 63) / 64;
+    std::vector<std::uint64_t> reach(std::size_t(n) * words, 0);
+    std::vector<std::uint64_t> below(words);
+    edges.clear();
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        unsigned int u = *it;
+        // elements strictly below the children of u
+        std::fill(below.begin(), below.end(), 0);
+        for (unsigned int v : children[u]) {
+            std::uint64_t const* rv = &reach[std::size_t(v) * words];
+            for (unsigned int w = 0; w < words; ++w) below[w] |= rv[w];
+        }
+        std::uint64_t* ru = &reach[std::size_t(u) * words];
+        for (unsigned int v : children[u]) {
+            if (!((below[v / 64] >> (v % 64)) & 1)) edges.emplace_back(u, v);
+            ru[v / 64] |= std::uint64_t(1) << (v % 64);
+        }
+        for (unsigned int w = 0; w < words; ++w) ru[w] |= below[w];
+    }
+    return true;
+}
+
+
+// Bounds on log(#extensions) of a poset. The elements with the same height
+// (length of the longest chain below them) form an antichain, so placing the
+// levels one after the other in any internal order gives prod |level|!
+// extensions. A partition into chains C_1, ..., C_k fixes the order inside
+// every chain, so there are at most n! / prod |C_i|! extensions. The chains are
+// built greedily in topological order.
+std::pair<NT, NT> log_extensions_bounds(unsigned int n, RELATIONS const& edges) {
+    std::vector<unsigned int> order;
+    topological_order(n, edges, order);
+
+    std::vector<std::vector<unsigned int>> parents(n);
+    for (auto const& edge : edges) {
+        parents[edge.second].push_back(edge.first);
+    }
+
+    std::vector<unsigned int> level(n, 0), chain(n), level_size(n, 0), chain_size;
+    std::vector<bool> extendable(n, false);
+    for (unsigned int u : order) {
+        for (unsigned int p : parents[u]) level[u] = std::max(level[u], level[p] + 1);
+        level_size[level[u]]++;
+
+        chain[u] = chain_size.size();
+        for (unsigned int p : parents[u]) {
+            if (extendable[p]) {
+                extendable[p] = false;
+                chain[u] = chain[p];
+                break;
+            }
+        }
+        if (chain[u] == chain_size.size()) chain_size.push_back(0);
+        chain_size[chain[u]]++;
+        extendable[u] = true;
+    }
+
+    NT lower = NT(0), upper = std::lgamma(NT(n) + 1);
+    for (unsigned int size : level_size) lower += std::lgamma(NT(size) + 1);
+    for (unsigned int size : chain_size) upper -= std::lgamma(NT(size) + 1);
+    return std::pair<NT, NT>(lower, upper);
+}
+
+
+// Returns log(#extensions) and its error bar. The number of extensions is
+// n! * vol(P), which overflows a double already for n around 170 while vol(P)
+// underflows, so only logarithms are combined here. Before the volume is
+// estimated, P is scaled by s such that the expected volume, the midpoint of
+// log_extensions_bounds - log(n!), becomes about 1 and then n*log(s) is
+// subtracted from the estimate.
+template <typename Polytope>
+std::pair<NT, NT> calculateLinearExtension(ArgOptions& args, Polytope& P) {
     // Setup parameters for calculating volume and rounding
-    unsigned int d = (args.HP)->dimension();
+    unsigned int d = P.dimension();
     unsigned int walk_len = 10 + d/10;
     NT e=0.1;
+    NT log_d_factorial = std::lgamma(NT(d) + 1);
+
     // calculate volume of the order polytope
-    NT round_multiply = 1.0;
+    NT log_round_multiply = 0.0;
     if (args.with_rounding) {
         //walk_len = 1;
 
         RNGType rng(d);
-        std::pair<Point, NT> InnerBall = (args.HP)->ComputeInnerBall();
-        //std::tuple<MT, VT, NT> res = args.rounding_method(*(args.HP), InnerBall, 10 + 10*d, rng);
-        std::tuple<MT, VT, NT> res = args.rounding_method(*(args.HP), InnerBall, 1, rng);
-        //std::tuple<MT, VT, NT> res = args.rounding_method(*(args.HP), InnerBall, .1, rng);
-        round_multiply = std::get<2>(res);
+        std::pair<Point, NT> InnerBall = P.ComputeInnerBall();
+        //std::tuple<MT, VT, NT> res = args.rounding_method(P, InnerBall, 10 + 10*d, rng);
+        std::tuple<MT, VT, NT> res = args.rounding_method(P, InnerBall, 1, rng);
+        //std::tuple<MT, VT, NT> res = args.rounding_method(P, InnerBall, .1, rng);
+        log_round_multiply = std::log(std::get<2>(res));
     }
-    NT volume = round_multiply * args.volume_method(*(args.HP), e, walk_len);
 
-    // multiplying by d factorial, d = number of elements
-    for(NT i=(NT)d; i>1; i-=1) {
-        volume = volume * i;
+    std::pair<NT, NT> bounds = log_extensions_bounds(args.n, args.relations);
+    NT log_volume_guess = (bounds.first + bounds.second) / NT(2) - log_d_factorial
+                          - log_round_multiply;
+    NT log_scale = -log_volume_guess / NT(d);
+    P.linear_transformIt(MT::Identity(d, d) * std::exp(-log_scale));
+
+    NT log_volume = std::log(args.volume_method(P, e, walk_len))
+                    - NT(d) * log_scale + log_round_multiply;
+
+    // the estimate has relative error e
+    return std::pair<NT, NT>(log_volume + log_d_factorial, std::log1p(e));
+}
+
+
+// Reads the poset as an n x n adjacency matrix of whitespace separated
+// integers, entry (a, b) is nonzero iff a<=b. n is the number of entries on the
+// first line and the other rows may wrap across lines. Only the relations are
+// kept. A token that is not an integer, or one after the n x n entries, is an error.
+bool read_poset_adjacency(std::istream& in, unsigned int& n, RELATIONS& edges) {
+    std::string line;
+    long x;
+    n = 0;
+    while (n == 0 && std::getline(in, line)) {
+        std::stringstream line_ss(line);
+        while (line_ss >> x) {
+            if (x) edges.emplace_back(0, n);
+            ++n;
+        }
+        if (!line_ss.eof()) return false;
+    }
+    if (n == 0) return false;
+
+    for (unsigned int a = 1; a < n; ++a) {
+        for (unsigned int b = 0; b < n; ++b) {
+            if (!(in >> x)) return false;
+            if (x) edges.emplace_back(a, b);
+        }
     }
-    return volume;
+
+    std::string rest;
+    return !(in >> rest);
+}
+
+
+// Reads the poset as the number of elements n followed by the relations
+// "a b" (0 <= a, b < n), one per line, meaning a<=b
+bool read_poset_edge_list(std::istream& in, unsigned int& n, RELATIONS& edges) {
+    if (!(in >> n) || n == 0) return false;
+    unsigned int a, b;
+    while (in >> a >> b) {
+        if (a >= n || b >= n) return false;
+        edges.emplace_back(a, b);
+    }
+    return in.eof();
 }
 
 
 bool parseArgs(int argc, char* argv[], ArgOptions& args) {
+    const unsigned long max_threads = 1024;
     if(argc < 3) {
         std::cerr << "Too few arguments";
-        std::cerr << "Usage: ./volesti_lecount INSTANCE VOLUME_METHOD ROUNDING_METHOD(optional) ";
+        std::cerr << "Usage: ./volesti_lecount INSTANCE VOLUME_METHOD ROUNDING_METHOD(optional) THREADS(optional) DENSE(optional) EDGELIST(optional) ";
         return false;
     }
 
@@ -124,57 +345,72 @@ bool parseArgs(int argc, char* argv[], ArgOptions& args) {
         return false;
     }
 
-    // create rounding method
-    if (argc == 4) {
-        std::string rm (argv[3]);
-        if (rm == "SVD") {
+    // create rounding method and number of threads
+    args.with_rounding = false;
+    bool edge_list = false;
+    for (int i = 3; i < argc; ++i) {
+        std::string opt (argv[i]);
+        if (opt == "SVD") {
             args.ro = SVD;
+            args.with_rounding = true;
         }
-        else if(rm == "MIN_ELLIPSOID") {
+        else if(opt == "MIN_ELLIPSOID") {
             args.ro = MIN_ELLIPSOID;
+            args.with_rounding = true;
+        }
+        else if(opt == "DENSE") {
+            args.dense = true;
+        }
+        else if(opt == "EDGELIST") {
+            edge_list = true;
+        }
+        else if(!opt.empty() && opt.find_first_not_of("0123456789") == std::string::npos) {
+            unsigned long n_threads = 0;
+            try {
+                n_threads = std::stoul(opt);
+            } catch (std::out_of_range const&) {}
+            if (n_threads == 0 || n_threads > max_threads) {
+                std::cerr << "The number of threads must be between 1 and " << max_threads;
+                return false;
+            }
+            args.n_threads = n_threads;
         }
         else {
-            std::cerr << "Invalid option for rounding method";
+            std::cerr << "Invalid option for rounding method, number of threads or representation";
             return false;
         }
-        args.with_rounding = true;
-    }
-    else {
-        args.with_rounding = false;
     }
 
     // ----- START: parse the instance file and create an order polytope ------
     std::string filename (argv[1]);
     std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "Cannot open " << filename;
+        return false;
+    }
 
     // for storing relations a<=b
-    std::vector<std::pair<int, int>> edges;
-    int n = 0;
-    int x;
-
-    // read a single line
-    std::string line;
-    std::getline(in, line);
-    std::stringstream line_ss(line);
-    while(line_ss >> x) {
-        if(x) {
-            edges.emplace_back(0, n);
-        }
-        ++n;
+    RELATIONS& edges = args.relations;
+    unsigned int& n = args.n;
+    if (edge_list ? !read_poset_edge_list(in, n, edges)
+                  : !read_poset_adjacency(in, n, edges)) {
+        std::cerr << (edge_list ? "Invalid edge list" : "Invalid adjacency matrix");
+        return false;
     }
 
-    // read rest of the lines
-    for(int a = 1; a < n; ++a) {
-        for(int b = 0; b < n; ++b) {
-            if(!(in >> x)) {
-                std::cerr << "Invalid adjacency matrix";
-                return false;
-            }
+    // the implied relations only add facets (and work per oracle call)
+    if (!transitive_reduction(n, edges)) {
+        std::cerr << "The relations contain a cycle";
+        return false;
+    }
 
-            if(x) {
-                edges.emplace_back(a, b);
-            }
+    if (!args.dense) {
+        Poset::RV relations;
+        for(int idx=0; idx<edges.size(); ++idx) {
+            relations.emplace_back(edges[idx].first, edges[idx].second);
         }
+        args.OP = new ORDERPOLYTOPE(Poset(n, relations));
+        return true;
     }
 
     MT A = Eigen::MatrixXd::Zero(2*n + edges.size(), n);
@@ -190,7 +426,7 @@ bool parseArgs(int argc, char* argv[], ArgOptions& args) {
 
     // next add the relations
     for(int idx=0; idx<edges.size(); ++idx) {
-        std::pair<int, int> edge  = edges[idx];
+        std::pair<unsigned int, unsigned int> edge  = edges[idx];
         A(2*n + idx, edge.first)  = 1;
         A(2*n + idx, edge.second) = -1;
     }
@@ -203,12 +439,22 @@ bool parseArgs(int argc, char* argv[], ArgOptions& args) {
 
 /**
  
- Usage: ./volesti_lecount INSTANCE VOLUME_METHOD ROUNDING_METHOD 
-        (ROUNDING_METHOD is optional) 
+ Usage: ./volesti_lecount INSTANCE VOLUME_METHOD ROUNDING_METHOD THREADS DENSE EDGELIST
+        (ROUNDING_METHOD, THREADS, DENSE and EDGELIST are optional, THREADS is used only by cb;
+         the order polytope of the poset is used unless DENSE is given, which builds
+         the same polytope as a dense H-polytope; INSTANCE is an adjacency matrix unless
+         EDGELIST is given, then it is the number of elements followed by one relation
+         "a b" per line)
+
+ Prints log(#linear extensions) with its error bar and #linear extensions in
+ scientific notation, which is exact in the exponent even when it overflows a double.
 
  example: for (volume method = sequence of balls, rounding method = SVD)
     ./volesti_lecount instances/bipartite_0.5_008_0.txt sob SVD
 
+ example: for (volume method = cooling balls, 8 threads)
+    ./volesti_lecount instances/bipartite_0.5_100_3.txt cb 8
+
 */
 int main(int argc, char* argv[]) {
     ArgOptions args;
@@ -217,7 +463,19 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    std::cout << calculateLinearExtension(args) << "\n";
+    std::pair<NT, NT> log_count = args.dense
+                                  ? calculateLinearExtension(args, *(args.HP))
+                                  : calculateLinearExtension(args, *(args.OP));
+
+    // every poset has at least one linear extension, so a noisy estimate of a
+    // near-chain poset is clamped to log(#linear extensions) >= 0
+    log_count.first = std::max(log_count.first, NT(0));
+    NT log10_count = log_count.first / std::log(NT(10));
+    NT exponent = std::floor(log10_count);
+    std::cout << "log(#linear extensions) = " << log_count.first
+              << " +- " << log_count.second << "\n";
+    std::cout << "#linear extensions = " << std::pow(NT(10), log10_count - exponent)
+              << "e+" << (long) exponent << "\n";
     return 0;
 }
 
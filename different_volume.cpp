@@ -24,6 +24,8 @@
 #include "volume/volume_cooling_gaussians.hpp"
 #include "volume/volume_cooling_gaussians.hpp"
 
+#include "log_volume.hpp"
+
 int main()
 {
     typedef double DBL;
@@ -86,6 +88,19 @@ int main()
               << volume_cooling_hpoly<CDHRWalk, RNG, Hpltp>(Z) << " , ";
     std::cout << (double)clock()/(double)CLOCKS_PER_SEC - tstart << std::endl;
 
+    tstart = (double)clock()/(double)CLOCKS_PER_SEC;
+    std::cout << "Zono CB log = "
+              << log_volume_cooling_hpoly<CDHRWalk, RNG, Hpltp>(Z) << " , ";
+    std::cout << (double)clock()/(double)CLOCKS_PER_SEC - tstart << std::endl;
+
+    // the volume 1/200! of the simplex underflows a double
+    Hpltp Simplex = generate_simplex<Hpltp>(200, false);
+    tstart = (double)clock()/(double)CLOCKS_PER_SEC;
+    std::cout << "Simplex-200 CB log = "
+              << log_volume_cooling_balls<CDHRWalk, RNG>(Simplex, 0.1, 2)
+              << " (exact " << -std::lgamma(201.0) << ") , ";
+    std::cout << (double)clock()/(double)CLOCKS_PER_SEC - tstart << std::endl;
+
 
     return 0;
 
@@ -0,0 +1,78 @@
+#ifndef LOG_VOLUME_HPP
+#define LOG_VOLUME_HPP
+
+#include <cmath>
+#include "volume/volume_sequence_of_balls.hpp"
+#include "volume/volume_cooling_gaussians.hpp"
+#include "volume/volume_cooling_balls.hpp"
+#include "volume/volume_cooling_hpoly.hpp"
+
+// log of the volume of the unit ball in R^d
+template <typename NT>
+NT log_unit_ball_volume(unsigned int d)
+{
+    return (NT(d) / NT(2)) * std::log(M_PI) - std::lgamma(NT(d) / NT(2) + NT(1));
+}
+
+// log(vol(P)) with the volume algorithm given by volume(P). The algorithms
+// multiply the volume of a ball with a product of ratios in NT, so in a few
+// hundred dimensions the result over- or underflows. Here a copy of P is
+// scaled by s such that its inner ball B(c, r) gets volume 1, i.e.
+// d*log(s*r) + log(vol(B_1)) = 0, and d*log(s) is subtracted from the log of
+// the estimate. The inner ball is inside P, so the scaled volume is at least
+// 1, and the ratios the algorithms multiply are bounded by vol(P) / vol(B(c, r)).
+template <typename Polytope, typename VolumeFunctor>
+typename Polytope::PointType::FT log_volume(Polytope P, VolumeFunctor volume)
+{
+    typedef typename Polytope::PointType::FT NT;
+    typedef typename Polytope::MT MT;
+
+    unsigned int d = P.dimension();
+    NT r = P.ComputeInnerBall().second;
+    NT log_scale = -std::log(r) - log_unit_ball_volume<NT>(d) / NT(d);
+
+    P.linear_transformIt(MT::Identity(d, d) * std::exp(-log_scale));
+    return std::log(volume(P)) - NT(d) * log_scale;
+}
+
+template <typename WalkType, typename RandomNumberGenerator, typename Polytope>
+double log_volume_sequence_of_balls(Polytope const& P,
+                                    double const& e = 0.1,
+                                    unsigned int const& walk_len = 1)
+{
+    return log_volume(P, [&](Polytope& Q) {
+        return volume_sequence_of_balls<WalkType, RandomNumberGenerator>(Q, e, walk_len);
+    });
+}
+
+template <typename WalkType, typename RandomNumberGenerator, typename Polytope>
+double log_volume_cooling_gaussians(Polytope const& P,
+                                    double const& e = 0.1,
+                                    unsigned int const& walk_len = 1)
+{
+    return log_volume(P, [&](Polytope& Q) {
+        return volume_cooling_gaussians<WalkType, RandomNumberGenerator>(Q, e, walk_len);
+    });
+}
+
+template <typename WalkType, typename RandomNumberGenerator, typename Polytope>
+double log_volume_cooling_balls(Polytope const& P,
+                                double const& e = 0.1,
+                                unsigned int const& walk_len = 1)
+{
+    return log_volume(P, [&](Polytope& Q) {
+        return volume_cooling_balls<WalkType, RandomNumberGenerator>(Q, e, walk_len).second;
+    });
+}
+
+template <typename WalkType, typename RandomNumberGenerator, typename HPolytope, typename Polytope>
+double log_volume_cooling_hpoly(Polytope const& P,
+                                double const& e = 0.1,
+                                unsigned int const& walk_len = 1)
+{
+    return log_volume(P, [&](Polytope& Q) {
+        return volume_cooling_hpoly<WalkType, RandomNumberGenerator, HPolytope>(Q, e, walk_len);
+    });
+}
+
+#endif
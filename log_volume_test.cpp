@@ -0,0 +1,61 @@
+#include "doctest.h"
+#include <cmath>
+#include <iostream>
+#include "known_polytope_generators.h"
+#include "misc.h"
+#include "random.hpp"
+#include "random/uniform_int.hpp"
+#include "random/normal_distribution.hpp"
+#include "random/uniform_real_distribution.hpp"
+#include "random_walks/random_walks.hpp"
+#include "log_volume.hpp"
+
+template <typename NT>
+void test_log_values(NT log_volume, NT exact_log_volume, NT e)
+{
+    NT relative_error = std::abs(std::exp(log_volume - exact_log_volume) - NT(1));
+    std::cout << "Computed log-volume " << log_volume << std::endl;
+    std::cout << "Exact log-volume = " << exact_log_volume << std::endl;
+    std::cout << "Relative error of the volume = " << relative_error << std::endl;
+    CHECK(relative_error < 2 * e);
+}
+
+template <typename NT>
+void call_test_log_volume_cube(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 200;
+    NT e = 0.1;
+
+    std::cout << "--- Testing log-volume of H-cube200" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    test_log_values(NT(log_volume_cooling_balls<CDHRWalk, RNGType>(P, e, 2)), NT(d) * std::log(NT(2)), e);
+}
+
+template <typename NT>
+void call_test_log_volume_simplex(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 200;
+    NT e = 0.1;
+
+    // the volume 1/200! of the simplex underflows a double
+    std::cout << "--- Testing log-volume of H-simplex200" << std::endl;
+    Hpolytope P = generate_simplex<Hpolytope>(d, false);
+    test_log_values(NT(log_volume_cooling_balls<CDHRWalk, RNGType>(P, e, 2)), -std::lgamma(NT(d) + 1), e);
+}
+
+
+TEST_CASE("log_volume_cube") {
+    call_test_log_volume_cube<double>();
+}
+
+TEST_CASE("log_volume_simplex") {
+    call_test_log_volume_simplex<double>();
+}
@@ -0,0 +1,347 @@
+#include <chrono>
+#include "doctest.h"
+#include "Eigen/Eigen"
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "known_polytope_generators.h"
+#include "misc.h"
+#include "random.hpp"
+#include "random/uniform_int.hpp"
+#include "random/normal_distribution.hpp"
+#include "random/uniform_real_distribution.hpp"
+#include "random_walks/random_walks.hpp"
+#include <string>
+#include <vector>
+
+
+// Random directions hit-and-run with the boundary oracle in OracleNT. A copy
+// of A is kept in OracleNT, so for OracleNT = float the product A*v, the O(md)
+// part of a step, moves half the bytes and uses twice the SIMD lanes of the
+// double one. The position x, the step along the chord and the slack b - Ax
+// stay in the NT of the polytope.
+//
+// Facet i of A*v in OracleNT is off by at most gamma * ||A_i||, with
+// gamma = (d + 1) * eps(OracleNT), and _slack_error * ||A_i|| bounds the error
+// that the slack updates have accumulated since the last refresh. The chord is
+// computed from the widest values these bounds allow, so it contains the exact
+// chord. After the step, the facets whose slack is within twice the error
+// bound of 0 are evaluated in NT, and the step is rejected if one of them is
+// not satisfied with a rounding margin, so no sample leaves P. Every
+// refresh_period steps the slack is recomputed from x in NT, which resets the
+// error bound.
+//
+// The widened chord depends on the slack and the error bound at the current
+// point, so from two points of the same line it generally has slightly
+// different lengths, and the walk is not exactly reversible. The lengths
+// differ relatively by O(gamma + _slack_error / chord length), so the
+// stationary distribution is uniform only up to a bias of float rounding
+// order, which is far below the statistical error of any estimate.
+template
+<
+    typename Polytope,
+    typename RandomNumberGenerator,
+    typename OracleNT = float
+>
+struct MixedPrecisionRDHRWalk
+{
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+    typedef Eigen::Matrix<OracleNT, Eigen::Dynamic, Eigen::Dynamic> OracleMT;
+    typedef Eigen::Matrix<OracleNT, Eigen::Dynamic, 1> OracleVT;
+
+    MixedPrecisionRDHRWalk(Polytope const& P,
+                           VT const& x0,
+                           unsigned int const& refresh_period = 64)
+        : _A(P.get_mat()), _b(P.get_vec()), _A_oracle(_A.template cast<OracleNT>()),
+          _A_row_norms(_A.rowwise().norm()),
+          _gamma(NT(_A.cols() + 1) * NT(std::numeric_limits<OracleNT>::epsilon())),
+          _refresh_period(refresh_period), _steps(0), _rejected(0), x(x0)
+    {
+        refresh();
+    }
+
+    // Returns (lambda_plus, lambda_minus) of a chord x + lambda*v that contains
+    // the exact one, given the slack b - Ax and Av with absolute errors at most
+    // slack_error * ||A_i|| and Av_error * ||A_i||
+    template <typename SlackVT, typename AvVT>
+    static std::pair<NT, NT> chord(SlackVT const& slack,
+                                   AvVT const& Av,
+                                   VT const& A_row_norms,
+                                   NT const& slack_error,
+                                   NT const& Av_error)
+    {
+        NT lambda_plus = std::numeric_limits<NT>::max();
+        NT lambda_minus = -std::numeric_limits<NT>::max();
+        for (unsigned int i = 0; i < slack.rows(); i++)
+        {
+            NT s = NT(slack(i)) + slack_error * A_row_norms(i);
+            NT a = NT(Av(i)), e = Av_error * A_row_norms(i);
+            if (a > e)
+            {
+                lambda_plus = std::min(lambda_plus, s / (a - e));
+            }
+            else if (a < -e)
+            {
+                lambda_minus = std::max(lambda_minus, s / (a + e));
+            }
+        }
+        return std::make_pair(lambda_plus, lambda_minus);
+    }
+
+    // Bound on the rounding error of b_i - A_i y in NT, for any summation order
+    NT rounding_error(unsigned int const& i, VT const& y) const
+    {
+        return NT(_A.cols() + 1) * std::numeric_limits<NT>::epsilon()
+               * (std::abs(_b(i)) + _A_row_norms(i) * y.norm());
+    }
+
+    void refresh()
+    {
+        _slack.noalias() = _b - _A * x;
+        _slack_error = NT(_A.cols() + 1) * std::numeric_limits<NT>::epsilon()
+                       * ((_b.cwiseAbs().array() / _A_row_norms.array()).maxCoeff() + x.norm());
+    }
+
+    void apply(unsigned int const& walk_length,
+               RandomNumberGenerator &rng)
+    {
+        unsigned int d = x.rows(), m = _b.rows();
+        VT v(d), y(d), slack(m);
+        OracleVT Av(m);
+
+        for (unsigned int j = 0u; j < walk_length; ++j)
+        {
+            for (unsigned int i = 0; i < d; i++)
+            {
+                v(i) = rng.sample_ndist();
+            }
+            v.normalize();
+
+            Av.noalias() = _A_oracle * v.template cast<OracleNT>();
+
+            std::pair<NT, NT> lambdas = chord(_slack, Av, _A_row_norms, _slack_error, _gamma);
+            if (lambdas.first == std::numeric_limits<NT>::max()
+                || lambdas.second == -std::numeric_limits<NT>::max())
+            {
+                // no facet bounds the chord beyond the error of Av, use A*v in NT
+                lambdas = chord(_slack, _A * v, _A_row_norms, _slack_error, NT(0));
+            }
+
+            NT t = lambdas.second + rng.sample_urdist() * (lambdas.first - lambdas.second);
+            y.noalias() = x + t * v;
+
+            NT slack_error = _slack_error + std::abs(t) * _gamma;
+            bool inside = true;
+            for (unsigned int i = 0; i < m && inside; i++)
+            {
+                slack(i) = _slack(i) - t * NT(Av(i));
+                if (slack(i) <= NT(2) * slack_error * _A_row_norms(i))
+                {
+                    slack(i) = _b(i) - _A.row(i).dot(y);
+                    inside = slack(i) >= NT(2) * rounding_error(i, y);
+                }
+            }
+
+            if (!inside)
+            {
+                _rejected++;
+            }
+            else
+            {
+                x.swap(y);
+                _slack.swap(slack);
+                _slack_error = slack_error;
+            }
+
+            if (++_steps % _refresh_period == 0)
+            {
+                refresh();
+            }
+        }
+    }
+
+    MT _A;
+    VT _b;
+    OracleMT _A_oracle;
+    VT _A_row_norms;
+    VT _slack;
+    NT _slack_error;
+    NT _gamma;
+    unsigned int _refresh_period;
+    unsigned long _steps;
+    unsigned long _rejected;
+    VT x;
+};
+
+
+template <typename NT>
+void call_test_mixed_precision_rdhr(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 10, walkL = 10, num_samples = 10000;
+
+    std::cout << "--- Testing mixed precision RDHR on H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    RNGType rng(d);
+
+    MixedPrecisionRDHRWalk<Hpolytope, RNGType> walk(P, VT::Zero(d));
+    MT samples(d, num_samples);
+    for (unsigned int i = 0; i < num_samples; i++)
+    {
+        walk.apply(walkL, rng);
+        samples.col(i) = walk.x;
+    }
+
+    // the uniform distribution on [-1,1]^d has mean 0 and variance 1/3
+    VT mean = samples.rowwise().mean();
+    VT variance = (samples.colwise() - mean).rowwise().squaredNorm() / NT(num_samples - 1);
+    std::cout << "max |mean| = " << mean.cwiseAbs().maxCoeff()
+              << ", max |variance - 1/3| = "
+              << (variance.array() - NT(1) / NT(3)).abs().maxCoeff() << std::endl;
+
+    NT violation = ((P.get_mat() * samples).colwise() - P.get_vec()).maxCoeff();
+    std::cout << "max constraint violation = " << violation
+              << ", rejected steps = " << walk._rejected << std::endl;
+
+    CHECK(mean.cwiseAbs().maxCoeff() < 0.05);
+    CHECK((variance.array() - NT(1) / NT(3)).abs().maxCoeff() < 0.03);
+    CHECK(violation <= NT(0));
+}
+
+
+// Runs num_samples draws of the walk with OracleNT and returns the samples,
+// the time per step, the worst constraint violation and the rejected steps
+template <typename OracleNT, typename Polytope, typename RNGType, typename MT>
+void run_mixed_precision_walk(Polytope const& P,
+                              unsigned int const& walk_len,
+                              RNGType &rng,
+                              MT &samples,
+                              double &time_per_step,
+                              double &violation,
+                              unsigned long &rejected)
+{
+    typedef typename Polytope::VT VT;
+
+    VT x0 = P.ComputeInnerBall().first.getCoefficients();
+    MixedPrecisionRDHRWalk<Polytope, RNGType, OracleNT> walk(P, x0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < samples.cols(); i++)
+    {
+        walk.apply(walk_len, rng);
+        samples.col(i) = walk.x;
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    time_per_step = double(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count())
+                    / (double(samples.cols()) * walk_len);
+    violation = ((P.get_mat() * samples).colwise() - P.get_vec()).maxCoeff();
+    rejected = walk._rejected;
+}
+
+
+// Returns the estimate of E||x - c||^2 over the columns of samples and its
+// standard error, computed from the means of num_batches consecutive batches
+template <typename NT, typename MT, typename VT>
+std::pair<NT, NT> second_moment_estimate(MT const& samples, VT const& c,
+                                         unsigned int const& num_batches = 10)
+{
+    Eigen::Matrix<NT, Eigen::Dynamic, 1> r2 = (samples.colwise() - c).colwise().squaredNorm().transpose();
+    unsigned int batch_size = r2.rows() / num_batches;
+    Eigen::Matrix<NT, Eigen::Dynamic, 1> batch_means(num_batches);
+    for (unsigned int i = 0; i < num_batches; i++)
+    {
+        batch_means(i) = r2.segment(i * batch_size, batch_size).mean();
+    }
+    NT mean = batch_means.mean();
+    NT variance = (batch_means.array() - mean).square().sum() / NT(num_batches - 1);
+    return std::make_pair(mean, std::sqrt(variance / NT(num_batches)));
+}
+
+
+// Compares the walk with the float oracle against the same walk in double: the
+// time per step and the estimate of the second moment E||x - c||^2 around the
+// center c of the inner ball. The difference of the two estimates is compared
+// with their batch means standard errors
+template <typename Polytope>
+void benchmark_mixed_precision(Polytope &P,
+                               std::string const& name,
+                               unsigned int const& walk_len = 10,
+                               unsigned int const& num_samples = 2000)
+{
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = P.dimension();
+    P.normalize();
+    std::cout << "--- Benchmark mixed precision RDHR on " << name << " (d = " << d
+              << ", m = " << P.num_of_hyperplanes() << ")" << std::endl;
+
+    MT samples_double(d, num_samples), samples_mixed(d, num_samples);
+    double time_double, time_mixed, violation_double, violation_mixed;
+    unsigned long rejected_double, rejected_mixed;
+
+    RNGType rng_double(d), rng_mixed(d);
+    run_mixed_precision_walk<double>(P, walk_len, rng_double, samples_double,
+                                     time_double, violation_double, rejected_double);
+    run_mixed_precision_walk<float>(P, walk_len, rng_mixed, samples_mixed,
+                                    time_mixed, violation_mixed, rejected_mixed);
+
+    VT c = P.ComputeInnerBall().first.getCoefficients();
+    std::pair<NT, NT> moment_double = second_moment_estimate<NT>(samples_double, c);
+    std::pair<NT, NT> moment_mixed = second_moment_estimate<NT>(samples_mixed, c);
+    NT z = std::abs(moment_mixed.first - moment_double.first)
+           / std::sqrt(moment_double.second * moment_double.second
+                       + moment_mixed.second * moment_mixed.second);
+
+    std::cout << "double, time per step (us): " << time_double
+              << ", max violation: " << violation_double
+              << ", rejected steps: " << rejected_double << std::endl;
+    std::cout << "mixed,  time per step (us): " << time_mixed
+              << ", max violation: " << violation_mixed
+              << ", rejected steps: " << rejected_mixed << std::endl;
+    std::cout << "E||x - c||^2: double = " << moment_double.first << " +- " << moment_double.second
+              << ", mixed = " << moment_mixed.first << " +- " << moment_mixed.second
+              << ", difference / standard error = " << z << std::endl;
+    std::cout << "speedup = " << time_double / time_mixed << std::endl;
+
+    CHECK(z < 4.0);
+    CHECK(violation_double <= 0.0);
+    CHECK(violation_mixed <= 0.0);
+}
+
+
+template <typename NT>
+void call_test_benchmark_mixed_precision(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    Hpolytope P;
+
+    P = generate_cube<Hpolytope>(100, false);
+    benchmark_mixed_precision(P, "H-cube100");
+
+    P = generate_birkhoff<Hpolytope>(10);
+    benchmark_mixed_precision(P, "H-birk10");
+
+    P = generate_skinny_cube<Hpolytope>(10, false);
+    benchmark_mixed_precision(P, "H-skinny_cube10", 100);
+}
+
+
+TEST_CASE("mixed_precision_rdhr") {
+    call_test_mixed_precision_rdhr<double>();
+}
+
+TEST_CASE("benchmark_mixed_precision") {
+    call_test_benchmark_mixed_precision<double>();
+}
@@ -2,7 +2,15 @@
 #include <boost/random/uniform_int.hpp>
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/uniform_real_distribution.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 #include "doctest.h"
 #include "diagnostics/multivariate_psrf.hpp"
 #include "diagnostics/univariate_psrf.hpp"
@@ -14,8 +22,339 @@
 #include "volume/volume_cooling_gaussians.hpp"
 
 
+// Growable column store for the MMCS samples. Every phase appends one chunk,
+// so nothing already stored is reallocated or copied; the chunks are joined
+// into one matrix only when the samples are handed out.
+template <typename MT>
+class mmcs_sample_store
+{
+public:
+    typedef typename MT::Scalar NT;
+
+    mmcs_sample_store() : _cols(0) {}
+
+    // Appends the rows of Y (one sample per row, as perform_mmcs_step returns
+    // them) mapped to the original space, T * y + T_shift, with one GEMM.
+    template <typename VT>
+    void append(MT const& Y, MT const& T, VT const& T_shift)
+    {
+        if (Y.rows() == 0) return;
+        _chunks.emplace_back(T.rows(), Y.rows());
+        _chunks.back().noalias() = T * Y.transpose();
+        _chunks.back().colwise() += T_shift;
+        _cols += Y.rows();
+    }
+
+    // Appends samples that are already in the original space, one per column
+    void append(MT const& S)
+    {
+        if (S.cols() == 0) return;
+        _chunks.push_back(S);
+        _cols += S.cols();
+    }
+
+    void append(MT &&S)
+    {
+        if (S.cols() == 0) return;
+        _cols += S.cols();
+        _chunks.push_back(std::move(S));
+    }
+
+    long cols() const
+    {
+        return _cols;
+    }
+
+    // Writes the samples in the format of write_matrix one chunk at a time,
+    // without joining them. The chunks are column-major with the same number
+    // of rows, so their concatenation is the column-major joined matrix.
+    void write(std::ofstream &out) const
+    {
+        long rows = _chunks.empty() ? 0 : _chunks[0].rows(), cols = _cols;
+        out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+        out.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+        for (MT const& chunk : _chunks)
+        {
+            out.write(reinterpret_cast<const char*>(chunk.data()),
+                      sizeof(NT) * chunk.size());
+        }
+    }
+
+    // Hands out the samples and empties the store. Each chunk is freed as soon
+    // as it is copied.
+    MT release()
+    {
+        MT S;
+        if (_chunks.size() == 1)
+        {
+            S = std::move(_chunks[0]);
+        }
+        else if (!_chunks.empty())
+        {
+            S.resize(_chunks[0].rows(), _cols);
+            long col = 0;
+            for (MT &chunk : _chunks)
+            {
+                S.middleCols(col, chunk.cols()) = chunk;
+                col += chunk.cols();
+                chunk.resize(0, 0);
+            }
+        }
+        _chunks.clear();
+        _cols = 0;
+        return S;
+    }
+
+private:
+    std::vector<MT> _chunks;
+    long _cols;
+};
+
+template <typename MT, typename VT>
+struct mmcs_checkpoint
+{
+    unsigned int phase = 0;
+    unsigned int Neff = 0;
+    unsigned int total_neff = 0;
+    unsigned int round_it = 1;
+    unsigned int total_number_of_samples_in_P0 = 0;
+    bool rounding_completed = false;
+    MT A;
+    VT b;
+    MT T;
+    VT T_shift;
+    // the samples, only filled by load_mmcs_checkpoint; save_mmcs_checkpoint
+    // writes them from the sample store
+    MT S;
+    // center and radius of the inner ball of the current polytope
+    VT inner_ball;
+};
+
+template <typename Matrix>
+void write_matrix(std::ofstream &out, Matrix const& M)
+{
+    long rows = M.rows(), cols = M.cols();
+    out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    out.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+    out.write(reinterpret_cast<const char*>(M.data()),
+              sizeof(typename Matrix::Scalar) * rows * cols);
+}
+
+// Reads a matrix written by write_matrix. A dimension given as -1 is free,
+// any other must match, and the payload may not exceed the bytes left in the
+// file, so a corrupt header never triggers a huge allocation
+template <typename Matrix>
+bool read_matrix(std::ifstream &in, Matrix &M,
+                 long const& expected_rows = -1, long const& expected_cols = -1)
+{
+    long rows, cols;
+    in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+    in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+    if (!in || rows < 0 || cols < 0) return false;
+    if ((expected_rows >= 0 && rows != expected_rows)
+        || (expected_cols >= 0 && cols != expected_cols)) return false;
+
+    std::streampos pos = in.tellg();
+    in.seekg(0, std::ios::end);
+    long remaining = long(in.tellg() - pos);
+    in.seekg(pos);
+    long scalar_size = long(sizeof(typename Matrix::Scalar));
+    if (cols > 0 && rows > remaining / scalar_size / cols) return false;
+
+    M.resize(rows, cols);
+    in.read(reinterpret_cast<char*>(M.data()), scalar_size * rows * cols);
+    return bool(in);
+}
+
+// The checkpoint is written to a temporary file which is then renamed,
+// so a run killed while writing leaves the previous checkpoint intact. If any
+// write fails (e.g. the disk is full) the temporary file is removed, the
+// previous checkpoint is kept and false is returned
+template <typename MT, typename VT>
+bool save_mmcs_checkpoint(std::string const& filename,
+                          mmcs_checkpoint<MT, VT> const& state,
+                          mmcs_sample_store<MT> const& samples)
+{
+    const unsigned int version = 2, scalar_size = sizeof(typename MT::Scalar);
+    std::string tmp_filename = filename + ".tmp";
+    std::ofstream out(tmp_filename, std::ios::binary);
+
+    out.write("MMCS", 4);
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&scalar_size), sizeof(scalar_size));
+    out.write(reinterpret_cast<const char*>(&state.phase), sizeof(state.phase));
+    out.write(reinterpret_cast<const char*>(&state.Neff), sizeof(state.Neff));
+    out.write(reinterpret_cast<const char*>(&state.total_neff), sizeof(state.total_neff));
+    out.write(reinterpret_cast<const char*>(&state.round_it), sizeof(state.round_it));
+    out.write(reinterpret_cast<const char*>(&state.total_number_of_samples_in_P0),
+              sizeof(state.total_number_of_samples_in_P0));
+    out.write(reinterpret_cast<const char*>(&state.rounding_completed),
+              sizeof(state.rounding_completed));
+    write_matrix(out, state.A);
+    write_matrix(out, state.b);
+    write_matrix(out, state.T);
+    write_matrix(out, state.T_shift);
+    samples.write(out);
+    write_matrix(out, state.inner_ball);
+    out.flush();
+    bool written = out.good();
+    out.close();
+
+    if (!written || out.fail()
+        || std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr << "Failed to write checkpoint file " << filename << std::endl;
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename MT, typename VT>
+bool load_mmcs_checkpoint(std::string const& filename,
+                          mmcs_checkpoint<MT, VT> &state)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+
+    char magic[4];
+    unsigned int version, scalar_size;
+    in.read(magic, 4);
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&scalar_size), sizeof(scalar_size));
+    if (!in || std::string(magic, 4) != "MMCS" || version != 2
+        || scalar_size != sizeof(typename MT::Scalar))
+    {
+        std::cerr << "Invalid checkpoint file " << filename << std::endl;
+        return false;
+    }
+
+    in.read(reinterpret_cast<char*>(&state.phase), sizeof(state.phase));
+    in.read(reinterpret_cast<char*>(&state.Neff), sizeof(state.Neff));
+    in.read(reinterpret_cast<char*>(&state.total_neff), sizeof(state.total_neff));
+    in.read(reinterpret_cast<char*>(&state.round_it), sizeof(state.round_it));
+    in.read(reinterpret_cast<char*>(&state.total_number_of_samples_in_P0),
+            sizeof(state.total_number_of_samples_in_P0));
+    in.read(reinterpret_cast<char*>(&state.rounding_completed),
+            sizeof(state.rounding_completed));
+
+    // A fixes the dimension d and the number of facets m, everything else
+    // has to agree with them
+    if (!read_matrix(in, state.A)) return false;
+    long m = state.A.rows(), d = state.A.cols();
+    if (read_matrix(in, state.b, m, 1) && read_matrix(in, state.T, d, d)
+        && read_matrix(in, state.T_shift, d, 1) && read_matrix(in, state.S)
+        && (state.S.cols() == 0 || state.S.rows() == d)
+        && read_matrix(in, state.inner_ball, d + 1, 1))
+    {
+        return true;
+    }
+    std::cerr << "Invalid checkpoint file " << filename << std::endl;
+    return false;
+}
+
+// Inner ball of P warm started from an interior point x, e.g. the image of the
+// previous center under the rounding map, instead of solving the Chebyshev
+// center LP from scratch. It takes steepest ascent steps on the radius
+// r(x) = min_i (b_i - A_i x) / ||A_i||: the direction is minus the minimum
+// norm point of the convex hull of the normalized rows within delta of the
+// minimum (found with Frank-Wolfe), the step maximizes r along it and delta
+// shrinks whenever no step improves r. An iteration costs O(m d) plus
+// Frank-Wolfe on the nearly active rows. If x is not interior, the LP is solved.
+template <typename Polytope, typename VT>
+std::pair<typename Polytope::PointType, typename Polytope::NT>
+warm_started_inner_ball(Polytope &P, VT x, unsigned int const& max_iterations = 30)
+{
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::PointType Point;
+
+    VT norms = P.get_mat().rowwise().norm();
+    MT A = norms.cwiseInverse().asDiagonal() * P.get_mat();
+    VT slack = P.get_vec().cwiseQuotient(norms) - A * x;
+    NT r = slack.minCoeff();
+    if (r <= NT(0))
+    {
+        return P.ComputeInnerBall();
+    }
+
+    std::vector<unsigned int> active;
+    NT delta = r / NT(2);
+    for (unsigned int it = 0; it < max_iterations && delta > NT(1e-9) * r; it++)
+    {
+        active.clear();
+        for (unsigned int i = 0; i < slack.size(); i++)
+        {
+            if (slack(i) <= r + delta) active.push_back(i);
+        }
+
+        VT p = A.row(active[0]).transpose();
+        for (unsigned int k = 0; k < 50; k++)
+        {
+            unsigned int best = active[0];
+            NT min_product = std::numeric_limits<NT>::max();
+            for (unsigned int i : active)
+            {
+                NT product = A.row(i).dot(p);
+                if (product < min_product)
+                {
+                    min_product = product;
+                    best = i;
+                }
+            }
+            VT q = A.row(best).transpose() - p;
+            NT gamma = -p.dot(q) / q.squaredNorm();
+            if (!(gamma > NT(0))) break;
+            p += std::min(gamma, NT(1)) * q;
+        }
+
+        if (p.norm() < NT(1e-9))
+        {
+            delta /= NT(4);
+            continue;
+        }
+        VT direction = -p / p.norm();
+        VT rate = A * direction;
+
+        // r along the direction is concave, ternary search for its maximum
+        auto radius = [&](NT t) { return (slack - t * rate).minCoeff(); };
+        NT lo = NT(0), hi = r;
+        while (radius(hi) > radius(hi / NT(2))) hi *= NT(2);
+        for (unsigned int k = 0; k < 50; k++)
+        {
+            NT t1 = lo + (hi - lo) / NT(3), t2 = hi - (hi - lo) / NT(3);
+            if (radius(t1) < radius(t2)) lo = t1;
+            else hi = t2;
+        }
+        NT t = (lo + hi) / NT(2), new_r = radius(t);
+
+        if (new_r <= r)
+        {
+            delta /= NT(4);
+            continue;
+        }
+        x += t * direction;
+        slack -= t * rate;
+        r = new_r;
+    }
+
+    return std::make_pair(Point(x), r);
+}
+
+// Runs MMCS and returns the samples in the original space. When checkpoint_file
+// is given, the state is saved at the end of every phase and a run resumes from
+// an existing checkpoint. The rng is reseeded at the start of every phase, so a
+// resumed run reproduces the uninterrupted one bit-for-bit. The run stops after
+// max_phases phases (0 means no limit).
+// In every phase num_chains independent chains run on their own threads, each
+// one with its own rng and its own copy of the current polytope, and each one
+// targets an equal share of the remaining effective sample size. The samples of
+// all the chains are pooled before rounding and the effective sample sizes of
+// the chains are added up.
 template <typename NT>
-void run_test() 
+Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> run_mmcs(std::string const& checkpoint_file = "",
+                                                           unsigned int max_phases = 0,
+                                                           unsigned int num_chains = 1)
 {
     typedef Cartesian<NT>    Kernel;
     typedef BoostRandomNumberGenerator<boost::mt19937, NT, 127> RNGType;
@@ -26,8 +365,9 @@ void run_test()
     typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
 
     int n = 50;
+    unsigned int seed = 127;
 
-    RNGType rng(n);
+    std::vector<RNGType> rngs(num_chains, RNGType(n));
     Hpolytope P = random_hpoly<Hpolytope, PolyRNGType>(n, 4*n, 127); // we fix the example polytope, seed = 127
     std::list<Point> randPoints;
     
@@ -42,15 +382,49 @@ void run_test()
          rounding_completed = false;
     bool req_round_temp = request_rounding;
 
+    // the LP for the inner ball is solved only once, after every rounding the
+    // inner ball is warm started from the image of the previous center
     std::pair<Point, NT> InnerBall;
+    bool inner_ball_valid = false;
     
-    MT S;
+    mmcs_sample_store<MT> samples;
+
+    mmcs_checkpoint<MT, VT> state;
+    if (!checkpoint_file.empty() && load_mmcs_checkpoint(checkpoint_file, state)
+        && state.A.cols() == n)
+    {
+        phase = state.phase;
+        Neff = state.Neff;
+        total_neff = state.total_neff;
+        round_it = state.round_it;
+        total_number_of_samples_in_P0 = state.total_number_of_samples_in_P0;
+        rounding_completed = state.rounding_completed;
+        P.set_mat(state.A);
+        P.set_vec(state.b);
+        T = state.T;
+        T_shift = state.T_shift;
+        samples.append(std::move(state.S));
+        state.S.resize(0, 0);
+        InnerBall = std::make_pair(Point(VT(state.inner_ball.head(n))), state.inner_ball(n));
+        inner_ball_valid = true;
+        std::cout << "resuming from phase " << phase << "\n" << std::endl;
+    }
 
     std::cout << "target effective sample size = " << Neff << "\n" << std::endl;
  
     while(true) 
     {
+        if (max_phases > 0 && phase >= max_phases)
+        {
+            break;
+        }
+
         phase++;
+        for (unsigned int c = 0; c < num_chains; c++)
+        {
+            rngs[c].set_seed(seed + (phase - 1) * num_chains + c + 1);
+        }
+
         if (request_rounding && rounding_completed) 
         {
             req_round_temp = false;
@@ -65,29 +439,55 @@ void run_test()
             nburns = max_num_samples / window + 1;
         }
 
-        InnerBall = P.ComputeInnerBall();
+        if (!inner_ball_valid)
+        {
+            InnerBall = P.ComputeInnerBall();
+            inner_ball_valid = true;
+        }
         L = NT(6) * std::sqrt(NT(n)) * InnerBall.second;
-        AcceleratedBilliardWalk WalkType(L);
 
-        unsigned int Neff_sampled;
-        MT TotalRandPoints;
-        complete = perform_mmcs_step(P, rng, walk_length, Neff, max_num_samples, window, 
-                                     Neff_sampled, total_samples, num_rounding_steps, TotalRandPoints,
-                                     InnerBall.first, nburns, req_round_temp, WalkType);
+        std::vector<MT> ChainRandPoints(num_chains);
+        std::vector<unsigned int> chain_neff(num_chains, 0), chain_samples(num_chains, 0);
+        std::vector<char> chain_complete(num_chains, 0);
+        std::vector<std::thread> chains;
+        unsigned int chain_target = (Neff + num_chains - 1) / num_chains;
+
+        for (unsigned int c = 0; c < num_chains; c++)
+        {
+            chains.emplace_back([&, c]() {
+                Hpolytope Pc(P);
+                AcceleratedBilliardWalk WalkType(L);
+                chain_complete[c] = perform_mmcs_step(Pc, rngs[c], walk_length, chain_target, max_num_samples, window,
+                                                      chain_neff[c], chain_samples[c], num_rounding_steps,
+                                                      ChainRandPoints[c], InnerBall.first, nburns, req_round_temp,
+                                                      WalkType);
+            });
+        }
+
+        unsigned int Neff_sampled = 0;
+        total_samples = 0;
+        complete = true;
+        for (unsigned int c = 0; c < num_chains; c++)
+        {
+            chains[c].join();
+            Neff_sampled += chain_neff[c];
+            total_samples += chain_samples[c];
+            complete = complete && chain_complete[c];
+        }
+        complete = complete || Neff_sampled >= Neff;
+
+        MT TotalRandPoints(total_samples, n);
+        for (unsigned int c = 0, row = 0; c < num_chains; row += chain_samples[c], c++)
+        {
+            TotalRandPoints.middleRows(row, chain_samples[c]) = ChainRandPoints[c].topRows(chain_samples[c]);
+        }
 
         Neff -= Neff_sampled;
         std::cout << "phase " << phase << ": number of correlated samples = " << total_samples << ", effective sample size = " << Neff_sampled;
         total_neff += Neff_sampled;
         Neff_sampled = 0;
         
-        MT Samples = TotalRandPoints.transpose(); //do not copy TODO!
-        for (int i = 0; i < total_samples; i++)
-        {
-            Samples.col(i) = T * Samples.col(i) + T_shift;
-        }
-        
-        S.conservativeResize(P.dimension(), total_number_of_samples_in_P0 + total_samples);
-        S.block(0, total_number_of_samples_in_P0, P.dimension(), total_samples) = Samples.block(0, 0, P.dimension(), total_samples);
+        samples.append(TotalRandPoints, T, T_shift);
         total_number_of_samples_in_P0 += total_samples;
         if (!complete) 
         {
@@ -131,9 +531,16 @@ void run_test()
                 round_it++;
                 P.shift(shift);
                 P.linear_transformIt(round_mat);
+                // the reflections of the billiard walk assume unit rows, the
+                // transform leaves them scaled by the singular values
+                P.normalize();
                 T_shift += T * shift;
                 T = T * round_mat;
 
+                // round_mat = V * S with V orthogonal, normalize() does not move the ball
+                InnerBall = warm_started_inner_ball(P, VT(s.cwiseInverse().asDiagonal() * V.transpose()
+                                                          * (InnerBall.first.getCoefficients() - shift)));
+
                 std::cout << ", ratio of the maximum singilar value over the minimum singular value = " << max_s << std::endl;
 
                 if (max_s <= s_cutoff || round_it > num_its) 
@@ -145,24 +552,275 @@ void run_test()
             {
                 std::cout<<"\n";
             }
+
+            if (!checkpoint_file.empty())
+            {
+                state.phase = phase;
+                state.Neff = Neff;
+                state.total_neff = total_neff;
+                state.round_it = round_it;
+                state.total_number_of_samples_in_P0 = total_number_of_samples_in_P0;
+                state.rounding_completed = rounding_completed;
+                state.A = P.get_mat();
+                state.b = P.get_vec();
+                state.T = T;
+                state.T_shift = T_shift;
+                state.inner_ball.resize(n + 1);
+                state.inner_ball << InnerBall.first.getCoefficients(), InnerBall.second;
+                save_mmcs_checkpoint(checkpoint_file, state, samples);
+            }
         } 
         else 
         {
             std::cout<<"\n\n";
+            if (!checkpoint_file.empty())
+            {
+                std::remove(checkpoint_file.c_str());
+            }
+            std::cerr << "sum of effective sample sizes: " << total_neff << std::endl;
             break;
         }
     } 
 
-    std::cerr << "sum of effective sample sizes: " << total_neff << std::endl;
+    return samples.release();
+}
+
+// Multivariate PSRF of Brooks and Gelman for samples (d x N) split into
+// num_splits consecutive chains whose lengths differ by at most one, so no
+// draw is dropped. The lower triangle of the within-chain covariance W is
+// split into column panels of panel_width columns and every thread fills its
+// own panels of W with GEMM updates over column blocks of the samples, so the
+// threads share W and no per-thread d x d accumulator is allocated. The
+// between-chain covariance B of the chain means has rank at most
+// num_splits - 1, so the largest eigenvalue of W^{-1} B is the largest
+// eigenvalue of the small symmetric matrix D^T W^{-1} D / (num_splits - 1),
+// D holding the centered chain means; after the Cholesky factorization of W
+// that costs O(d^2) per chain and no d x d eigenproblem is solved.
+template <typename NT, typename VT, typename MT>
+NT blocked_multivariate_psrf(MT const& samples,
+                             unsigned int num_splits = 2,
+                             unsigned int num_threads = 0,
+                             unsigned int block_size = 256,
+                             unsigned int panel_width = 128)
+{
+    unsigned int d = samples.rows(), N = samples.cols();
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // chain j holds the columns [starts[j], starts[j + 1])
+    std::vector<unsigned int> starts(num_splits + 1);
+    for (unsigned int j = 0; j <= num_splits; j++)
+    {
+        starts[j] = (unsigned long long) j * N / num_splits;
+    }
+
+    MT means(d, num_splits);
+    for (unsigned int j = 0; j < num_splits; j++)
+    {
+        means.col(j) = samples.middleCols(starts[j], starts[j + 1] - starts[j]).rowwise().mean();
+    }
+
+    // column blocks of the samples, each one inside a single chain, as
+    // (chain, first column, number of columns)
+    std::vector<std::tuple<unsigned int, unsigned int, unsigned int> > blocks;
+    for (unsigned int j = 0; j < num_splits; j++)
+    {
+        for (unsigned int start = starts[j]; start < starts[j + 1]; start += block_size)
+        {
+            blocks.push_back(std::make_tuple(j, start, std::min(block_size, starts[j + 1] - start)));
+        }
+    }
+
+    unsigned int num_panels = (d + panel_width - 1) / panel_width;
+    num_threads = std::min(num_threads, num_panels);
+
+    // the panel of the columns [c0, c0 + w) of W gets the rows [c0, d)
+    MT W = MT::Zero(d, d);
+    auto accumulate = [&](unsigned int t) {
+        MT centered;
+        for (unsigned int panel = t; panel < num_panels; panel += num_threads)
+        {
+            unsigned int c0 = panel * panel_width, w = std::min(panel_width, d - c0), h = d - c0;
+            for (std::tuple<unsigned int, unsigned int, unsigned int> const& block : blocks)
+            {
+                centered = samples.block(c0, std::get<1>(block), h, std::get<2>(block)).colwise()
+                           - means.col(std::get<0>(block)).segment(c0, h);
+                W.block(c0, c0, h, w).noalias() += centered * centered.topRows(w).transpose();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < num_threads; t++) threads.emplace_back(accumulate, t);
+    accumulate(0);
+    for (std::thread &thread : threads) thread.join();
+
+    W /= NT(N - num_splits);
+
+    MT D = means.colwise() - means.rowwise().mean();
+    Eigen::LLT<MT> llt(W.template selfadjointView<Eigen::Lower>());
+    MT L_inv_D = llt.matrixL().solve(D);
+    MT reduced = (L_inv_D.transpose() * L_inv_D) / NT(num_splits - 1);
+    NT lambda = Eigen::SelfAdjointEigenSolver<MT>(reduced, Eigen::EigenvaluesOnly).eigenvalues().maxCoeff();
+
+    NT n = NT(N) / NT(num_splits);
+    return (n - NT(1)) / n + (NT(num_splits) + NT(1)) / NT(num_splits) * lambda;
+}
+
+// Compares blocked_multivariate_psrf with multivariate_psrf. The dimensions of
+// the scaling benchmark (up to d = 2000) run only when VOLESTI_BENCHMARK is
+// defined. An odd number of draws checks that the last draw is used.
+template <typename NT>
+void run_test_multivariate_psrf_scaling()
+{
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+
+#ifdef VOLESTI_BENCHMARK
+    std::vector<unsigned int> dims{500, 1000, 2000};
+#else
+    std::vector<unsigned int> dims{50, 200};
+#endif
+    for (unsigned int d : dims)
+    {
+        unsigned int N = 4 * d;
+        MT S = MT::Random(d, N);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        NT R = multivariate_psrf<NT, VT>(S);
+        auto stop = std::chrono::high_resolution_clock::now();
+        long ETA = (long) std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        NT R_blocked = blocked_multivariate_psrf<NT, VT, MT>(S);
+        stop = std::chrono::high_resolution_clock::now();
+        long ETA_blocked = (long) std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+
+        std::cerr << "d = " << d << ", N = " << N << ": multivariate PSRF = " << R << " (" << ETA
+                  << " ms), blocked = " << R_blocked << " (" << ETA_blocked << " ms)" << std::endl;
+
+        CHECK(std::abs(R - R_blocked) < 1e-6 * R);
+    }
+
+    // with N odd the two chains have (N - 1) / 2 and (N + 1) / 2 draws, so
+    // changing the last draw changes the result
+    unsigned int d = 5, N = 2001;
+    MT S = MT::Random(d, N);
+    NT R = blocked_multivariate_psrf<NT, VT, MT>(S);
+    S.col(N - 1) *= NT(100);
+    NT R_last = blocked_multivariate_psrf<NT, VT, MT>(S);
+    std::cerr << "d = " << d << ", N = " << N << ": blocked PSRF = " << R
+              << ", with the last draw scaled = " << R_last << std::endl;
+    CHECK(std::abs(R - NT(1)) < 0.1);
+    CHECK(R_last != R);
+}
+
+template <typename NT>
+void run_test(unsigned int num_chains = 1) 
+{
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MT S = run_mmcs<NT>("", 0, num_chains);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    std::cerr << "number of chains: " << num_chains << ", ETA (ms): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << std::endl;
+
     std::cerr << "multivariate PSRF: " <<  multivariate_psrf<NT, VT>(S) << std::endl;
+    std::cerr << "multivariate PSRF (blocked): " <<  blocked_multivariate_psrf<NT, VT, MT>(S) << std::endl;
     std::cerr << "maximum marginal PSRF: " <<  univariate_psrf<NT, VT>(S).maxCoeff() << std::endl;
     CHECK(univariate_psrf<NT, VT>(S).maxCoeff() < 1.1);
+
+    // the first phase rounds with singular value ratio > 2, the samples of the
+    // later phases come from the rescaled polytope and must map back into P0
+    typedef Cartesian<NT>    Kernel;
+    typedef HPolytope<typename Kernel::Point> Hpolytope;
+    Hpolytope P0 = random_hpoly<Hpolytope, boost::mt19937>(50, 200, 127);
+    MT slack = (P0.get_mat() * S).colwise() - P0.get_vec();
+    std::cerr << "maximum constraint violation in P0: " << slack.maxCoeff() << std::endl;
+    CHECK(slack.maxCoeff() < 1e-8);
+}
+
+template <typename NT>
+void run_test_checkpoint() 
+{
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    std::string checkpoint_file = "mmcs_checkpoint.bin";
+    std::remove(checkpoint_file.c_str());
+
+    MT S = run_mmcs<NT>();
+
+    // stop after the second phase as a killed run would, then resume
+    MT S_interrupted = run_mmcs<NT>(checkpoint_file, 2);
+    MT S_resumed = run_mmcs<NT>(checkpoint_file);
+
+    CHECK(S_interrupted.cols() < S.cols());
+    CHECK(S_resumed.rows() == S.rows());
+    CHECK(S_resumed.cols() == S.cols());
+    CHECK(S_resumed == S);
+}
+
+template <typename NT>
+void run_test_warm_started_inner_ball()
+{
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef boost::mt19937 PolyRNGType;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+
+    unsigned int n = 50;
+    Hpolytope P = random_hpoly<Hpolytope, PolyRNGType>(n, 4*n, 127);
+    std::pair<Point, NT> InnerBall = P.ComputeInnerBall();
+
+    // a rounding step as in run_mmcs: shift, rotate and stretch
+    VT shift = VT::Constant(n, NT(0.1) * InnerBall.second);
+    MT V = Eigen::HouseholderQR<MT>(MT::Random(n, n)).householderQ();
+    VT s = VT::LinSpaced(n, NT(1), NT(5));
+    P.shift(shift);
+    P.linear_transformIt(V * s.asDiagonal());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::pair<Point, NT> warm = warm_started_inner_ball(P, VT(s.cwiseInverse().asDiagonal() * V.transpose()
+                                                              * (InnerBall.first.getCoefficients() - shift)));
+    auto stop = std::chrono::high_resolution_clock::now();
+    long warm_time = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    std::pair<Point, NT> lp = P.ComputeInnerBall();
+    stop = std::chrono::high_resolution_clock::now();
+    long lp_time = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    std::cerr << "inner ball radius, warm started: " << warm.second << " (" << warm_time
+              << " us), LP: " << lp.second << " (" << lp_time << " us)" << std::endl;
+
+    CHECK(P.is_in(warm.first) == -1);
+    CHECK(warm.second <= lp.second * (NT(1) + 1e-8));
+    CHECK(warm.second >= NT(0.9) * lp.second);
 }
 
 TEST_CASE("mmcs") {
     run_test<double>();
 }
 
+TEST_CASE("mmcs_parallel") {
+    run_test<double>(4);
+}
+
+TEST_CASE("mmcs_checkpoint") {
+    run_test_checkpoint<double>();
+}
+
+TEST_CASE("multivariate_psrf_scaling") {
+    run_test_multivariate_psrf_scaling<double>();
+}
+
+TEST_CASE("warm_started_inner_ball") {
+    run_test_warm_started_inner_ball<double>();
+}
+
 /*
 
 [doctest] doctest version is "1.2.9"
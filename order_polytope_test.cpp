@@ -1,12 +1,18 @@
 #include "cartesian_geom/cartesian_kernel.h"
 #include "cartesian_geom/point.h"
+#include <chrono>
 #include "doctest.h"
+#include "hpolytope.h"
 #include <fstream>
 #include <iostream>
 #include "misc.h"
 #include "orderpolytope.h"
 #include "poset.h"
+#include "preprocess/svd_rounding.hpp"
 #include "random.hpp"
+#include "random_walks/random_walks.hpp"
+#include <tuple>
+#include "volume_cooling_balls.hpp"
 
 
 template <typename NT>
@@ -143,6 +149,93 @@ void call_test_basics() {
 }
 
 
+template <typename NT>
+void call_test_volume() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point Pnt;
+    typedef typename OrderPolytope<Pnt>::MT MT;
+    typedef typename OrderPolytope<Pnt>::VT VT;
+    typedef typename Poset::RV RV;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 5> RNGType;
+
+    // a0 <= a1, a0 <= a2, a1 <= a3 has 3 linear extensions out of 4! orders
+    RV poset_data{{0, 1}, {0, 2}, {1, 3}};
+    Poset poset(4, poset_data);
+    unsigned int n = poset.num_elem();
+    NT exact = NT(3) / NT(24);
+
+    OrderPolytope<Pnt> OP(poset);
+
+    // the same polytope as a dense H-polytope
+    MT A = MT::Zero(2*n + poset_data.size(), n);
+    VT b = VT::Zero(2*n + poset_data.size());
+    A.topLeftCorner(n, n) = -MT::Identity(n, n);
+    A.block(n, 0, n, n) = MT::Identity(n, n);
+    b.segment(n, n) = VT::Ones(n);
+    for (unsigned int idx = 0; idx < poset_data.size(); ++idx) {
+        A(2*n + idx, poset_data[idx].first) = 1;
+        A(2*n + idx, poset_data[idx].second) = -1;
+    }
+    HPolytope<Pnt> HP(n, A, b);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    NT order_volume = volume_cooling_balls<CDHRWalk, RNGType>(OP, 0.1, 20).second;
+    auto stop = std::chrono::high_resolution_clock::now();
+    long order_ETA = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    NT dense_volume = volume_cooling_balls<CDHRWalk, RNGType>(HP, 0.1, 20).second;
+    stop = std::chrono::high_resolution_clock::now();
+    long dense_ETA = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    std::cout << "order polytope volume = " << order_volume << " (" << order_ETA << " us), "
+              << "dense H-polytope volume = " << dense_volume << " (" << dense_ETA << " us), "
+              << "exact = " << exact << std::endl;
+
+    CHECK(std::abs(order_volume - exact) / exact < 0.2);
+    CHECK(std::abs(dense_volume - exact) / exact < 0.2);
+}
+
+// Counts the linear extensions of a poset as n! vol(P) after rescaling P and
+// after rounding it with svd_rounding, as lecount does, and compares both
+// counts with the exact one
+template <typename NT>
+void call_test_volume_rounded() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point Pnt;
+    typedef typename OrderPolytope<Pnt>::MT MT;
+    typedef typename OrderPolytope<Pnt>::VT VT;
+    typedef typename Poset::RV RV;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 5> RNGType;
+
+    // a0 <= a1, a0 <= a2, a1 <= a3, a2 <= a4 has 6 linear extensions
+    RV poset_data{{0, 1}, {0, 2}, {1, 3}, {2, 4}};
+    Poset poset(5, poset_data);
+    unsigned int n = poset.num_elem();
+    NT exact = NT(6), n_factorial = NT(120);
+
+    // x -> x / 2 scales the volume by 2^n
+    OrderPolytope<Pnt> OP(poset);
+    NT scale = NT(2);
+    OP.linear_transformIt(MT::Identity(n, n) / scale);
+    NT scaled_count = n_factorial * volume_cooling_balls<CDHRWalk, RNGType>(OP, 0.1, 20).second
+                      / std::pow(scale, NT(n));
+
+    // svd_rounding returns the factor by which it shrinks the volume
+    OrderPolytope<Pnt> OP_rounded(poset);
+    RNGType rng(n);
+    std::pair<Pnt, NT> inner_ball = OP_rounded.ComputeInnerBall();
+    std::tuple<MT, VT, NT> res = svd_rounding<CDHRWalk, MT, VT>(OP_rounded, inner_ball, 1, rng);
+    NT rounded_count = n_factorial * volume_cooling_balls<CDHRWalk, RNGType>(OP_rounded, 0.1, 20).second
+                       * std::get<2>(res);
+
+    std::cout << "linear extensions, rescaled: " << scaled_count << ", rounded: " << rounded_count
+              << ", exact = " << exact << std::endl;
+
+    CHECK(std::abs(scaled_count - exact) / exact < 0.2);
+    CHECK(std::abs(rounded_count - exact) / exact < 0.2);
+}
+
 TEST_CASE("basics") {
     call_test_basics<double>();
 }
@@ -159,6 +252,14 @@ TEST_CASE("vec_mult") {
     call_test_vec_mult<double>();
 }
 
+TEST_CASE("volume") {
+    call_test_volume<double>();
+}
+
+TEST_CASE("volume_rounded") {
+    call_test_volume_rounded<double>();
+}
+
 
 /*
 
@@ -2,6 +2,7 @@
 #include "diagnostics/univariate_psrf.hpp"
 #include <fstream>
 #include <iostream>
+#include <vector>
 #include "known_polytope_generators.h"
 #include "misc.h"
 #include "random.hpp"
@@ -19,27 +20,56 @@ template
     typename WalkType,
     typename Polytope
 >
-MT get_samples(Polytope &P)
+MT get_samples(Polytope &P, unsigned int num_chains = 1)
 {
     typedef typename Polytope::PointType Point;
     typedef typename Polytope::NT NT;
+    typedef typename Polytope::VT VT;
 
     typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+    typedef typename WalkType::template Walk<Polytope, RNGType> Walk;
 
-    unsigned int walkL = 10, numpoints = 10000, nburns = 0, d = P.dimension();
+    unsigned int walkL = 10, numpoints = 10000, d = P.dimension();
+    // every chain gets the same length, so numpoints is rounded up
+    unsigned int chain_length = (numpoints + num_chains - 1) / num_chains;
     RNGType rng(d);
-    Point StartingPoint(d);
-    std::list<Point> randPoints;
 
-    uniform_sampling<WalkType>(randPoints, P, rng, walkL, numpoints,
-                               StartingPoint, nburns);
+    // the first chain starts at the origin, the others at a random fraction
+    // of the chord from the origin along a random direction, so the chains
+    // are overdispersed as the psrf assumes
+    std::vector<Point> chain_points(num_chains, Point(d));
+    for (unsigned int k = 1; k < num_chains; k++)
+    {
+        VT direction(d);
+        for (unsigned int j = 0; j < d; j++)
+        {
+            direction(j) = rng.sample_ndist();
+        }
+        direction.normalize();
+        Point v(d);
+        v.set_coeffs(direction);
+        NT lambda = P.line_intersect(chain_points[k], v).first;
+        chain_points[k].set_coeffs(NT(0.9) * rng.sample_urdist() * lambda * direction);
+    }
 
-    MT samples(d, numpoints);
-    unsigned int jj = 0;
+    std::vector<Walk> walks;
+    walks.reserve(num_chains);
+    for (unsigned int k = 0; k < num_chains; k++)
+    {
+        walks.emplace_back(P, chain_points[k], rng);
+    }
 
-    for (typename std::list<Point>::iterator rpit = randPoints.begin(); rpit!=randPoints.end(); rpit++, jj++)
+    // The chains advance in lockstep and each one writes its points straight
+    // into its own block of columns, so there is no intermediate point list
+    MT samples(d, num_chains * chain_length);
+
+    for (unsigned int i = 0; i < chain_length; i++)
     {
-        samples.col(jj) = (*rpit).getCoefficients();
+        for (unsigned int k = 0; k < num_chains; k++)
+        {
+            walks[k].apply(P, chain_points[k], walkL, rng);
+            samples.col(k * chain_length + i) = chain_points[k].getCoefficients();
+        }
     }
 
     return samples;
@@ -0,0 +1,663 @@
+#include <chrono>
+#include "doctest.h"
+#include "Eigen/Eigen"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "known_polytope_generators.h"
+#include "misc.h"
+#include "random.hpp"
+#include "random/uniform_int.hpp"
+#include "random/normal_distribution.hpp"
+#include "random/uniform_real_distribution.hpp"
+#include "random_walks/random_walks.hpp"
+#include "volume/volume_cooling_balls.hpp"
+#include <thread>
+#include <vector>
+
+
+// Counter-based Philox4x32-10 engine (Salmon et al., "Parallel random numbers:
+// as easy as 1, 2, 3"). The i-th block of four outputs of stream s is the
+// bijection of the counter (i, s) keyed by the seed, so discard(z) is O(1) and
+// every stream is an independent sequence of 2^66 numbers. The state is the
+// 64-bit key, the 128-bit counter (block, stream), and the last block of four
+// outputs with the index of the next one, which saves three of every four
+// evaluations of the rounds: 48 bytes with padding, against about 2.5 KB for
+// mt19937. It models the uniform random number generator concept, so it can
+// replace boost::mt19937 as the first template parameter of
+// BoostRandomNumberGenerator. There set_seed(s) keys the engine with s, and
+// distinct keys give independent sequences just as distinct streams do.
+class philox4x32
+{
+public:
+    typedef std::uint32_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit philox4x32(std::uint64_t const& seed = 0, std::uint64_t const& stream = 0)
+    {
+        this->seed(seed, stream);
+    }
+
+    void seed(std::uint64_t const& seed = 0, std::uint64_t const& stream = 0)
+    {
+        _key = seed;
+        _stream = stream;
+        _block = 0;
+        _index = 4;
+    }
+
+    // moves to the beginning of the given stream of the same seed
+    void set_stream(std::uint64_t const& stream)
+    {
+        seed(_key, stream);
+    }
+
+    result_type operator()()
+    {
+        if (_index == 4)
+        {
+            generate(_block++);
+            _index = 0;
+        }
+        return _output[_index++];
+    }
+
+    void discard(unsigned long long z)
+    {
+        // the position in the stream is 4 * _block - (4 - _index)
+        unsigned long long position = 4 * _block - (4 - _index) + z;
+        _block = position / 4;
+        _index = 4;
+        if (position % 4 != 0)
+        {
+            generate(_block++);
+            _index = position % 4;
+        }
+    }
+
+    // the ten rounds of Philox on one 128-bit counter
+    static void block(result_type counter[4], result_type const key[2])
+    {
+        const std::uint64_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+        const result_type W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+        result_type k0 = key[0], k1 = key[1];
+
+        for (unsigned int round = 0; round < 10; round++)
+        {
+            std::uint64_t p0 = M0 * counter[0], p1 = M1 * counter[2];
+            result_type c1 = counter[1], c3 = counter[3];
+            counter[0] = result_type(p1 >> 32) ^ c1 ^ k0;
+            counter[1] = result_type(p1);
+            counter[2] = result_type(p0 >> 32) ^ c3 ^ k1;
+            counter[3] = result_type(p0);
+            k0 += W0;
+            k1 += W1;
+        }
+    }
+
+    friend bool operator==(philox4x32 const& a, philox4x32 const& b)
+    {
+        return a._key == b._key && a._stream == b._stream
+               && 4 * a._block - (4 - a._index) == 4 * b._block - (4 - b._index);
+    }
+
+    friend bool operator!=(philox4x32 const& a, philox4x32 const& b)
+    {
+        return !(a == b);
+    }
+
+private:
+    void generate(std::uint64_t const& block_index)
+    {
+        result_type key[2] = {result_type(_key), result_type(_key >> 32)};
+        _output[0] = result_type(block_index);
+        _output[1] = result_type(block_index >> 32);
+        _output[2] = result_type(_stream);
+        _output[3] = result_type(_stream >> 32);
+        block(_output, key);
+    }
+
+    std::uint64_t _key;
+    std::uint64_t _stream;
+    std::uint64_t _block;
+    result_type _output[4];
+    unsigned int _index;
+};
+
+static_assert(sizeof(philox4x32) <= 48, "the state of philox4x32 is the key, the counter and one block");
+
+
+// Tables of the 128-layer ziggurat of Marsaglia and Tsang for the standard
+// normal: layer i is accepted without further tests if |j| < k[i] for the
+// signed 32-bit integer j, and then x = j * w[i]
+template <typename NT>
+struct ziggurat_tables
+{
+    std::uint32_t k[128];
+    NT w[128];
+    NT f[128];
+
+    ziggurat_tables()
+    {
+        const double m = 2147483648.0, v = 9.91256303526217e-3;
+        double dn = 3.442619855899, tn = dn;
+        double q = v / std::exp(-0.5 * dn * dn);
+
+        k[0] = std::uint32_t((dn / q) * m);
+        k[1] = 0;
+        w[0] = NT(q / m);
+        w[127] = NT(dn / m);
+        f[0] = NT(1);
+        f[127] = NT(std::exp(-0.5 * dn * dn));
+        for (int i = 126; i >= 1; i--)
+        {
+            dn = std::sqrt(-2.0 * std::log(v / dn + std::exp(-0.5 * dn * dn)));
+            k[i + 1] = std::uint32_t((dn / tn) * m);
+            tn = dn;
+            f[i] = NT(std::exp(-0.5 * dn * dn));
+            w[i] = NT(dn / m);
+        }
+    }
+};
+
+
+// Drop-in replacement of BoostRandomNumberGenerator that draws the numbers in
+// blocks: the raw 32-bit outputs of Engine for a whole block are generated in
+// one loop and then turned into uniforms or ziggurat normals in a second loop
+// over the block, whose fast path (99% of the draws) is a table lookup and a
+// multiplication. sample_ndist() and sample_urdist() return the next entry of
+// the buffers and refill them when they run out, so any walk gets the bulk
+// generation without changes. fill_normals() and fill_directions() fill whole
+// matrices for batched walks.
+template
+<
+    typename Engine,
+    typename NT,
+    unsigned int Seed = 0
+>
+class BufferedRandomNumberGenerator
+{
+public:
+    typedef Eigen::Array<NT, Eigen::Dynamic, 1> AT;
+
+    BufferedRandomNumberGenerator(int d, unsigned int const& buffer_size = 1024)
+        : _engine(Seed), _uidist(0, d - 1),
+          _normals(buffer_size), _uniforms(buffer_size),
+          _normal_index(buffer_size), _uniform_index(buffer_size)
+    {}
+
+    NT sample_urdist()
+    {
+        if (_uniform_index == _uniforms.size())
+        {
+            fill_uniforms(_uniforms.data(), _uniforms.size());
+            _uniform_index = 0;
+        }
+        return _uniforms(_uniform_index++);
+    }
+
+    NT sample_ndist()
+    {
+        if (_normal_index == _normals.size())
+        {
+            fill_normals(_normals.data(), _normals.size());
+            _normal_index = 0;
+        }
+        return _normals(_normal_index++);
+    }
+
+    int sample_uidist()
+    {
+        return _uidist(_engine);
+    }
+
+    void set_seed(unsigned int rng_seed)
+    {
+        _engine.seed(rng_seed);
+        _normal_index = _normals.size();
+        _uniform_index = _uniforms.size();
+    }
+
+    // n uniforms in [0, 1), with the 32-bit resolution of boost's uniform_real_distribution
+    void fill_uniforms(NT* out, unsigned int const& n)
+    {
+        generate_raw(n);
+        const NT scale = NT(1) / NT(4294967296.0); // 2^-32
+        Eigen::Map<AT>(out, n) = Eigen::Map<Eigen::Array<std::uint32_t, Eigen::Dynamic, 1>>(
+                                     _raw.data(), n).template cast<NT>() * scale;
+    }
+
+    // n standard normals. The layer of the i-th draw is taken from byte i%4
+    // of an extra output of Engine per four draws, so it is independent of the
+    // bits of j.
+    void fill_normals(NT* out, unsigned int const& n)
+    {
+        static const ziggurat_tables<NT> t;
+        unsigned int num_layer_words = (n + 3) / 4;
+        generate_raw(n + num_layer_words);
+        const std::uint32_t* layer_words = _raw.data() + n;
+
+        for (unsigned int i = 0; i < n; i++)
+        {
+            std::int32_t j = std::int32_t(_raw[i]);
+            unsigned int layer = (layer_words[i / 4] >> (8 * (i % 4))) & 127;
+            NT x = NT(j) * t.w[layer];
+            while (abs32(j) >= t.k[layer])
+            {
+                if (layer == 0)
+                {
+                    x = normal_tail(j > 0);
+                    break;
+                }
+                if (t.f[layer] + uniform() * (t.f[layer - 1] - t.f[layer]) < std::exp(NT(-0.5) * x * x))
+                {
+                    break;
+                }
+                j = std::int32_t(_engine());
+                layer = _engine() & 127;
+                x = NT(j) * t.w[layer];
+            }
+            out[i] = x;
+        }
+    }
+
+    template <typename MT>
+    void fill_normals(MT &M)
+    {
+        fill_normals(M.data(), M.size());
+    }
+
+    // uniform directions on the sphere in the columns of V
+    template <typename MT>
+    void fill_directions(MT &V)
+    {
+        fill_normals(V);
+        V.colwise().normalize();
+    }
+
+private:
+    void generate_raw(unsigned int const& n)
+    {
+        _raw.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            _raw[i] = std::uint32_t(_engine());
+        }
+    }
+
+    static std::uint32_t abs32(std::int32_t const& j)
+    {
+        return j < 0 ? 0u - std::uint32_t(j) : std::uint32_t(j);
+    }
+
+    // uniform in (0, 1)
+    NT uniform()
+    {
+        return (NT(std::uint32_t(_engine())) + NT(0.5)) / NT(4294967296.0);
+    }
+
+    // normal conditioned on |x| > r, the base layer of the ziggurat
+    NT normal_tail(bool positive)
+    {
+        const NT r = NT(3.442619855899);
+        NT x, y;
+        do
+        {
+            x = -std::log(uniform()) / r;
+            y = -std::log(uniform());
+        } while (y + y < x * x);
+        return positive ? r + x : -r - x;
+    }
+
+    Engine _engine;
+    boost::random::uniform_int_distribution<> _uidist;
+    std::vector<std::uint32_t> _raw;
+    AT _normals;
+    AT _uniforms;
+    unsigned int _normal_index;
+    unsigned int _uniform_index;
+};
+
+
+// Samples num_chains CDHR chains of P with num_threads threads. Chain c draws
+// from the generator keyed with c, whichever thread runs it, so the samples do
+// not depend on num_threads. Column c * chain_length + i is the i-th point of chain c.
+template <typename RNGType, typename Polytope>
+typename Polytope::MT parallel_cdhr_sampling(Polytope const& P,
+                                             unsigned int const& num_chains,
+                                             unsigned int const& chain_length,
+                                             unsigned int const& walk_len,
+                                             unsigned int const& num_threads)
+{
+    typedef typename Polytope::PointType Point;
+    typedef typename Polytope::MT MT;
+
+    unsigned int d = P.dimension();
+    MT samples(d, num_chains * chain_length);
+    Point center = Polytope(P).ComputeInnerBall().first;
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (unsigned int c = t; c < num_chains; c += num_threads)
+            {
+                Polytope Pc(P);
+                RNGType rng(d);
+                rng.set_seed(c);
+                Point p = center;
+                CDHRWalk::Walk<Polytope, RNGType> walk(Pc, p, rng);
+                for (unsigned int i = 0; i < chain_length; i++)
+                {
+                    walk.apply(Pc, p, walk_len, rng);
+                    samples.col(c * chain_length + i) = p.getCoefficients();
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    return samples;
+}
+
+
+// Runs num_estimates cooling balls estimations of the volume of P with
+// num_threads threads. Estimation i draws from the generator keyed with i,
+// whichever thread runs it, so the estimates do not depend on num_threads.
+template <typename RNGType, typename Polytope>
+std::vector<typename Polytope::NT> parallel_volume_cooling_balls(Polytope const& P,
+                                                                 unsigned int const& num_estimates,
+                                                                 typename Polytope::NT const& e,
+                                                                 unsigned int const& walk_len,
+                                                                 unsigned int const& num_threads)
+{
+    typedef typename Polytope::NT NT;
+
+    std::vector<NT> volumes(num_estimates, NT(0));
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (unsigned int i = t; i < num_estimates; i += num_threads)
+            {
+                Polytope Pi(P);
+                RNGType rng(Pi.dimension());
+                rng.set_seed(i);
+                volumes[i] = volume_cooling_balls<CDHRWalk>(Pi, rng, e, walk_len).second;
+            }
+        });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    return volumes;
+}
+
+
+void call_test_philox_known_answers(){
+    // test vectors of the Random123 distribution
+    std::uint32_t counters[3][4] = {{0, 0, 0, 0},
+                                    {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                                    {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+    std::uint32_t keys[3][2] = {{0, 0},
+                                {0xffffffff, 0xffffffff},
+                                {0xa4093822, 0x299f31d0}};
+    std::uint32_t expected[3][4] = {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+                                    {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+                                    {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        philox4x32::block(counters[i], keys[i]);
+        for (unsigned int j = 0; j < 4; j++)
+        {
+            CHECK(counters[i][j] == expected[i][j]);
+        }
+    }
+}
+
+void call_test_philox_streams(){
+    std::cout << "--- Testing philox4x32 jump ahead and streams" << std::endl;
+    std::cout << "state size (bytes): philox4x32 = " << sizeof(philox4x32)
+              << ", mt19937 = " << sizeof(boost::mt19937) << std::endl;
+    CHECK(sizeof(philox4x32) <= 48);
+
+    philox4x32 sequential(7), jumped(7);
+    std::vector<std::uint32_t> draws(1000);
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        draws[i] = sequential();
+    }
+    for (unsigned int z : {0u, 1u, 3u, 4u, 5u, 998u})
+    {
+        jumped.seed(7);
+        jumped.discard(z);
+        CHECK(jumped() == draws[z]);
+    }
+    jumped.seed(7);
+    jumped.discard(13);
+    sequential.seed(7);
+    for (unsigned int i = 0; i < 13; i++) sequential();
+    CHECK(jumped == sequential);
+
+    philox4x32 stream0(7, 0), stream1(7, 1);
+    unsigned int equal = 0;
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        if (stream0() == stream1()) equal++;
+    }
+    CHECK(equal == 0);
+}
+
+template <typename NT>
+void call_test_philox_distributions(){
+    typedef BoostRandomNumberGenerator<philox4x32, NT, 3> RNGType;
+
+    std::cout << "--- Testing BoostRandomNumberGenerator with philox4x32" << std::endl;
+    RNGType rng(10);
+    unsigned int N = 100000;
+    NT sum_u = 0, sum_u2 = 0, sum_n = 0, sum_n2 = 0;
+    for (unsigned int i = 0; i < N; i++)
+    {
+        NT u = rng.sample_urdist(), n = rng.sample_ndist();
+        sum_u += u;
+        sum_u2 += u * u;
+        sum_n += n;
+        sum_n2 += n * n;
+    }
+    NT mean_u = sum_u / N, var_u = sum_u2 / N - mean_u * mean_u;
+    NT mean_n = sum_n / N, var_n = sum_n2 / N - mean_n * mean_n;
+    std::cout << "uniform: mean = " << mean_u << ", variance = " << var_u << std::endl;
+    std::cout << "normal: mean = " << mean_n << ", variance = " << var_n << std::endl;
+
+    CHECK(std::abs(mean_u - 0.5) < 0.01);
+    CHECK(std::abs(var_u - 1.0 / 12.0) < 0.01);
+    CHECK(std::abs(mean_n) < 0.02);
+    CHECK(std::abs(var_n - 1.0) < 0.02);
+}
+
+template <typename NT>
+void call_test_reproducible_parallel_sampling(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef BoostRandomNumberGenerator<philox4x32, NT, 3> RNGType;
+
+    unsigned int d = 10, num_chains = 8, chain_length = 100, walk_len = 5;
+
+    std::cout << "--- Testing reproducible parallel CDHR on H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+
+    MT reference = parallel_cdhr_sampling<RNGType>(P, num_chains, chain_length, walk_len, 1);
+    for (unsigned int num_threads : {2u, 3u, 8u})
+    {
+        MT samples = parallel_cdhr_sampling<RNGType>(P, num_chains, chain_length,
+                                                     walk_len, num_threads);
+        std::cout << num_threads << " threads, identical to 1 thread: "
+                  << (samples == reference) << std::endl;
+        CHECK(samples == reference);
+    }
+}
+
+
+template <typename NT>
+void call_test_reproducible_parallel_volume(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef BoostRandomNumberGenerator<philox4x32, NT, 3> RNGType;
+
+    unsigned int d = 10, num_estimates = 4, walk_len = 10;
+    NT e = 0.1, exact = std::pow(NT(2), NT(d));
+
+    std::cout << "--- Testing reproducible parallel volume on H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+
+    std::vector<NT> reference = parallel_volume_cooling_balls<RNGType>(P, num_estimates, e,
+                                                                       walk_len, 1);
+    NT volume = NT(0);
+    for (NT const& v : reference) volume += v;
+    volume /= NT(num_estimates);
+    std::cout << "volume = " << volume << ", relative error = "
+              << std::abs((volume - exact) / exact) << std::endl;
+    CHECK(std::abs((volume - exact) / exact) < 0.2);
+
+    for (unsigned int num_threads : {2u, 4u})
+    {
+        std::vector<NT> volumes = parallel_volume_cooling_balls<RNGType>(P, num_estimates, e,
+                                                                         walk_len, num_threads);
+        std::cout << num_threads << " threads, identical to 1 thread: "
+                  << (volumes == reference) << std::endl;
+        CHECK(volumes == reference);
+    }
+}
+
+
+template <typename NT>
+void call_test_buffered_rng(){
+    typedef BufferedRandomNumberGenerator<philox4x32, NT, 3> RNGType;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+
+    std::cout << "--- Testing buffered random number generator" << std::endl;
+    RNGType rng(10);
+    unsigned int N = 100000;
+    VT u(N), n(N);
+    for (unsigned int i = 0; i < N; i++)
+    {
+        u(i) = rng.sample_urdist();
+        n(i) = rng.sample_ndist();
+    }
+    NT mean_u = u.mean(), var_u = (u.array() - mean_u).square().mean();
+    NT mean_n = n.mean(), var_n = (n.array() - mean_n).square().mean();
+    NT kurtosis_n = (n.array() - mean_n).pow(4).mean() / (var_n * var_n);
+    std::cout << "uniform: mean = " << mean_u << ", variance = " << var_u << std::endl;
+    std::cout << "normal: mean = " << mean_n << ", variance = " << var_n
+              << ", kurtosis = " << kurtosis_n << std::endl;
+
+    CHECK(u.minCoeff() >= NT(0));
+    CHECK(u.maxCoeff() < NT(1));
+    CHECK(std::abs(mean_u - 0.5) < 0.01);
+    CHECK(std::abs(var_u - 1.0 / 12.0) < 0.01);
+    CHECK(std::abs(mean_n) < 0.02);
+    CHECK(std::abs(var_n - 1.0) < 0.02);
+    CHECK(std::abs(kurtosis_n - 3.0) < 0.1);
+
+    // the same seed gives the same numbers
+    RNGType rng2(10);
+    rng.set_seed(5);
+    rng2.set_seed(5);
+    MT V(10, 7), W(10, 7);
+    rng.fill_directions(V);
+    rng2.fill_directions(W);
+    CHECK(V == W);
+    CHECK((V.colwise().norm().array() - NT(1)).abs().maxCoeff() < 1e-12);
+}
+
+template <typename RNGType, typename Hpolytope>
+double rdhr_time_per_step(Hpolytope &P, unsigned int const& num_steps)
+{
+    typedef typename Hpolytope::PointType Point;
+
+    unsigned int d = P.dimension();
+    RNGType rng(d);
+    Point p = P.ComputeInnerBall().first;
+    RDHRWalk::Walk<Hpolytope, RNGType> walk(P, p, rng);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    walk.apply(P, p, num_steps, rng);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    CHECK(P.is_in(p) == -1);
+    return double(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / num_steps;
+}
+
+template <typename NT>
+void call_test_benchmark_buffered_rng(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+    typedef BufferedRandomNumberGenerator<boost::mt19937, NT, 3> BufferedRNGType;
+
+    unsigned int N = 1000000;
+    NT sum = 0;
+    std::cout << "--- Benchmark buffered random number generation" << std::endl;
+
+    RNGType rng(100);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < N; i++) sum += rng.sample_ndist();
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "scalar normals, time per draw (ns): "
+              << NT(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / N
+              << std::endl;
+
+    BufferedRNGType buffered_rng(100);
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < N; i++) sum += buffered_rng.sample_ndist();
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "buffered normals, time per draw (ns): "
+              << NT(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / N
+              << std::endl;
+    std::cout << "(sum = " << sum << ")" << std::endl;
+
+    Hpolytope P = generate_cube<Hpolytope>(100, false);
+    std::cout << "RDHR on H-cube100, time per step (us): scalar = "
+              << rdhr_time_per_step<RNGType>(P, 100000) << ", buffered = "
+              << rdhr_time_per_step<BufferedRNGType>(P, 100000) << std::endl;
+}
+
+
+TEST_CASE("philox_known_answers") {
+    call_test_philox_known_answers();
+}
+
+TEST_CASE("philox_streams") {
+    call_test_philox_streams();
+}
+
+TEST_CASE("philox_distributions") {
+    call_test_philox_distributions<double>();
+}
+
+TEST_CASE("reproducible_parallel_sampling") {
+    call_test_reproducible_parallel_sampling<double>();
+}
+
+TEST_CASE("reproducible_parallel_volume") {
+    call_test_reproducible_parallel_volume<double>();
+}
+
+TEST_CASE("buffered_rng") {
+    call_test_buffered_rng<double>();
+}
+
+TEST_CASE("benchmark_buffered_rng") {
+    call_test_benchmark_buffered_rng<double>();
+}
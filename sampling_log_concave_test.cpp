@@ -1,8 +1,16 @@
 #include "convex_bodies/spectrahedra/spectrahedron.h"
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include "doctest.h"
 #include "diagnostics/diagnostics.hpp"
 #include "Eigen/Eigen"
@@ -12,6 +20,8 @@
 #include "generators/convex_bodies_generator.h"
 #include "misc/misc.h"
 #include "matrix_operations/EigenvaluesProblems.h"
+#include <memory>
+#include <mutex>
 #include "ode_solvers.hpp"
 #include "preprocess/svd_rounding.hpp"
 #include "random.hpp"
@@ -20,10 +30,13 @@
 #include "random/uniform_real_distribution.hpp"
 #include "random_walks/random_walks.hpp"
 #include "SDPAFormatManager.h"
+#include <sstream>
 #include <string>
 #include <tuple>
 #include <typeinfo>
 #include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "volume/volume_sequence_of_balls.hpp"
 #include "volume/volume_cooling_gaussians.hpp"
@@ -190,6 +203,69 @@ struct CustomFunctor {
 
 };
 
+struct PreconditionedFunctor {
+
+  // Density of y = L^{-1} (x - shift) when x has the density of the wrapped
+  // functors. HMC on y with identity mass matrix is HMC on x with mass matrix
+  // (L L^T)^{-1}.
+  template
+  <
+      typename Point,
+      typename Functor,
+      typename Parameters
+  >
+  struct GradientFunctor {
+    typedef typename Point::FT NT;
+    typedef std::vector<Point> pts;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, 1> VT;
+
+    Functor &F;
+    Parameters &params;
+    MT L;
+    VT shift;
+
+    GradientFunctor(Functor &F_, MT const& L_, VT const& shift_) :
+      F(F_), params(F_.params), L(L_), shift(shift_) {};
+
+    // The index i represents the state vector index
+    Point operator() (unsigned int const& i, pts const& ys, NT const& t) const {
+      if (i == params.order - 1) {
+        pts xs(ys);
+        xs[0] = Point(VT(L * ys[0].getCoefficients() + shift));
+        return Point(VT(L.transpose() * F(i, xs, t).getCoefficients()));
+      } else {
+        return ys[i + 1]; // returns derivative
+      }
+    }
+
+  };
+
+  template
+  <
+    typename Point,
+    typename Functor
+  >
+  struct FunctionFunctor {
+    typedef typename Point::FT NT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, 1> VT;
+
+    Functor &f;
+    MT L;
+    VT shift;
+
+    FunctionFunctor(Functor &f_, MT const& L_, VT const& shift_) :
+      f(f_), L(L_), shift(shift_) {};
+
+    NT operator() (Point const& y) const {
+      return f(Point(VT(L * y.getCoefficients() + shift)));
+    }
+
+  };
+
+};
+
 template <typename NT, typename VT, typename MT>
 NT check_interval_psrf(MT &samples, NT target=NT(1.2)) {
     NT max_psrf = NT(0);
@@ -357,6 +433,36 @@ void test_uld() {
 
 }
 
+// Preprocessing of a polytope that can be reused by later runs: the inner ball
+// and, if requested, the rounding transform T, T_shift with log|det(T)|. The
+// inner ball is the one of the preprocessed (rounded) polytope. The key is a
+// content hash of the original (A, b).
+template <typename Polytope>
+struct preprocess_bundle {
+    typedef typename Polytope::PointType Point;
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+
+    std::uint64_t key = 0;
+    std::pair<Point, NT> inner_ball;
+    bool rounded = false;
+    bool from_cache = false;
+    MT T;
+    VT T_shift;
+    NT log_det = NT(0);
+};
+
+// File of the preprocessing of the polytope with content hash key in cache_dir
+inline std::string preprocess_cache_filename(std::string const& cache_dir,
+                                             std::uint64_t key,
+                                             bool rounding) {
+    std::stringstream filename;
+    filename << cache_dir << "/preprocess_" << std::hex << key
+             << (rounding ? "_rounded" : "") << ".bin";
+    return filename.str();
+}
+
 template <typename NT, typename Polytope>
 std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
     Polytope &P,
@@ -366,7 +472,9 @@ std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
     bool centered=false,
     bool warmstart=true,
     unsigned int max_draws=80000,
-    unsigned int num_burns=20000) {
+    unsigned int num_burns=20000,
+    preprocess_bundle<Polytope> const* bundle=NULL,
+    std::ostream &out=std::cout) {
     typedef Cartesian<NT>    Kernel;
     typedef typename Kernel::Point    Point;
     typedef std::vector<Point> pts;
@@ -385,6 +493,8 @@ std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
     if (centered) {
         inner_ball.first = Point(P.dimension());
         inner_ball.second = NT(1); // dummy radius (not correct one)
+    } else if (bundle != NULL) {
+        inner_ball = bundle->inner_ball;
     } else {
         inner_ball = P.ComputeInnerBall();
     }
@@ -397,8 +507,8 @@ std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
     NT R0 = inner_ball.second;
     unsigned int dim = x0.dimension();
 
-    if (rounding) {
-        std::cout << "SVD Rounding" << std::endl;
+    if (rounding && (bundle == NULL || !bundle->rounded)) {
+        out << "SVD Rounding" << std::endl;
         svd_rounding<AcceleratedBilliardWalk, MT, VT>(P, inner_ball, walk_length, rng);
     }
 
@@ -421,34 +531,34 @@ std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
     std::chrono::time_point<std::chrono::high_resolution_clock> start, stop;
 
     if (warmstart) {
-        std::cout << "Gaussian Hit and Run" << std::endl;
+        out << "Gaussian Hit and Run" << std::endl;
 
-        std::cout << "Burn-in" << std::endl;
+        out << "Burn-in" << std::endl;
 
         for (unsigned int i = 0; i < num_burns; i++) {
-          if (i % 1000 == 0) std::cout << ".";
+          if (i % 1000 == 0) out << ".";
           gaussian_walk.apply(P, x0, params.L, walk_length, rng);
           // std::cout << x0.getCoefficients() << std::endl;
         }
 
-        std::cout << std::endl;
-        std::cout << "Sampling" << std::endl;
+        out << std::endl;
+        out << "Sampling" << std::endl;
 
         start = std::chrono::high_resolution_clock::now();
         for (unsigned int i = 0; i < max_actual_draws; i++) {
           gaussian_walk.apply(P, x0, params.L, walk_length, rng);
           samples.col(i) = x0.getCoefficients();
-          if (i % 1000 == 0 && i > 0) std::cout << ".";
+          if (i % 1000 == 0 && i > 0) out << ".";
         }
         stop = std::chrono::high_resolution_clock::now();
 
         ETA = (NT) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
 
-        std::cout << std::endl;
-        print_diagnostics<NT, VT, MT>(samples, min_ess, std::cout);
-        std::cout << "Average time per sample: " << ETA / max_actual_draws << "us" << std::endl;
-        std::cout << "Average time per independent sample: " << ETA / min_ess << "us" << std::endl;
-        std::cout << std::endl;
+        out << std::endl;
+        print_diagnostics<NT, VT, MT>(samples, min_ess, out);
+        out << "Average time per sample: " << ETA / max_actual_draws << "us" << std::endl;
+        out << "Average time per independent sample: " << ETA / min_ess << "us" << std::endl;
+        out << std::endl;
 
         max_psrf = check_interval_psrf<NT, VT, MT>(samples);
 
@@ -468,42 +578,42 @@ std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
 
     min_ess = 0;
 
-    std::cout << "Hamiltonian Monte Carlo (Gaussian Density)" << std::endl;
+    out << "Hamiltonian Monte Carlo (Gaussian Density)" << std::endl;
 
     if (eta > 0) hmc.solver->eta = eta;
 
-    std::cout << "Burn-in" << std::endl;
+    out << "Burn-in" << std::endl;
 
     for (unsigned int i = 0; i < num_burns; i++) {
-      if (i % 1000 == 0) std::cout << ".";
+      if (i % 1000 == 0) out << ".";
       hmc.apply(rng, walk_length);
     }
 
     hmc.disable_adaptive();
-    std::cout << std::endl;
-    std::cout << "Sampling" << std::endl;
+    out << std::endl;
+    out << "Sampling" << std::endl;
 
     start = std::chrono::high_resolution_clock::now();
     for (unsigned int i = 0; i < max_actual_draws; i++) {
       hmc.apply(rng, walk_length);
       samples.col(i) = hmc.x.getCoefficients();
-      if (i % 1000 == 0 && i > 0) std::cout << ".";
+      if (i % 1000 == 0 && i > 0) out << ".";
     }
     stop = std::chrono::high_resolution_clock::now();
 
     ETA = (NT) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
 
-    std::cout << std::endl;
-    print_diagnostics<NT, VT, MT>(samples, min_ess, std::cout);
-    std::cout << "min ess " << min_ess << "us" << std::endl;
-    std::cout << "Average time per sample: " << ETA / max_actual_draws << "us" << std::endl;
-    std::cout << "Average time per independent sample: " << ETA / min_ess << "us" << std::endl;
-    std::cout << "Average number of reflections: " <<
+    out << std::endl;
+    print_diagnostics<NT, VT, MT>(samples, min_ess, out);
+    out << "min ess " << min_ess << "us" << std::endl;
+    out << "Average time per sample: " << ETA / max_actual_draws << "us" << std::endl;
+    out << "Average time per independent sample: " << ETA / min_ess << "us" << std::endl;
+    out << "Average number of reflections: " <<
         (1.0 * hmc.solver->num_reflections) / hmc.solver->num_steps << std::endl;
-    std::cout << "Step size (final): " << hmc.solver->eta << std::endl;
-    std::cout << "Discard Ratio: " << hmc.discard_ratio << std::endl;
-    std::cout << "Average Acceptance Probability: " << exp(hmc.average_acceptance_log_prob) << std::endl;
-    std::cout << std::endl;
+    out << "Step size (final): " << hmc.solver->eta << std::endl;
+    out << "Discard Ratio: " << hmc.discard_ratio << std::endl;
+    out << "Average Acceptance Probability: " << exp(hmc.average_acceptance_log_prob) << std::endl;
+    out << std::endl;
 
     max_psrf = check_interval_psrf<NT, VT, MT>(samples);
 
@@ -521,6 +631,573 @@ std::vector<SimulationStats<NT>> benchmark_polytope_sampling(
 }
 
 
+// Dual averaging of the step size towards a target acceptance rate, as in the
+// warmup of NUTS (Hoffman and Gelman, 2014, Section 3.2)
+template <typename NT>
+struct dual_averaging {
+    NT delta;
+    NT mu;
+    NT log_eta;
+    NT log_eta_bar = NT(0);
+    NT H_bar = NT(0);
+    NT gamma = NT(0.05);
+    NT t0 = NT(10);
+    NT kappa = NT(0.75);
+    unsigned int m = 0;
+
+    dual_averaging(NT eta0, NT target_acceptance=NT(0.8)) :
+        delta(target_acceptance), mu(std::log(10 * eta0)), log_eta(std::log(eta0)) {}
+
+    NT update(NT acceptance) {
+        m++;
+        NT w = NT(1) / (m + t0);
+        H_bar = (NT(1) - w) * H_bar + w * (delta - acceptance);
+        log_eta = mu - std::sqrt(NT(m)) / gamma * H_bar;
+        NT mk = std::pow(NT(m), -kappa);
+        log_eta_bar = mk * log_eta + (NT(1) - mk) * log_eta_bar;
+        return std::exp(log_eta);
+    }
+
+    NT final_eta() const {
+        return std::exp(log_eta_bar);
+    }
+};
+
+// Number of leapfrog steps of a trajectory of the given integration time
+template <typename NT>
+unsigned int hmc_num_steps(NT integration_time, NT eta, unsigned int max_steps=1000) {
+    return (unsigned int) std::min(NT(max_steps), std::max(NT(1), std::ceil(integration_time / eta)));
+}
+
+// Runs num_iterations HMC transitions adapting hmc.solver->eta by dual
+// averaging and leaves the final averaged step size in the walk. When samples
+// is given, its columns are filled with the states of the last iterations.
+template <typename NT, typename Walk, typename RandomNumberGenerator, typename MT>
+NT hmc_dual_averaging(Walk &hmc,
+                      RandomNumberGenerator &rng,
+                      NT integration_time,
+                      unsigned int num_iterations,
+                      MT *samples=NULL,
+                      NT target_acceptance=NT(0.8)) {
+    dual_averaging<NT> adaptation(hmc.solver->eta, target_acceptance);
+    unsigned int num_samples = samples == NULL ? 0 : samples->cols();
+
+    for (unsigned int i = 0; i < num_iterations; i++) {
+        NT total_acceptance_log_prob = hmc.total_acceptance_log_prob;
+        hmc.apply(rng, hmc_num_steps(integration_time, hmc.solver->eta));
+        NT acceptance = std::exp(std::min(NT(0), NT(hmc.total_acceptance_log_prob - total_acceptance_log_prob)));
+        hmc.solver->eta = adaptation.update(acceptance);
+
+        if (i + num_samples >= num_iterations) {
+            samples->col(i + num_samples - num_iterations) = hmc.x.getCoefficients();
+        }
+    }
+
+    hmc.solver->eta = adaptation.final_eta();
+    return hmc.solver->eta;
+}
+
+// HMC on P with a warmup in the style of Stan instead of a sweep over step
+// sizes and walk lengths. The first half of the warmup adapts the step size
+// by dual averaging and its last half is used to estimate the covariance of
+// the target. That gives a diagonal (or, with dense_metric, dense) mass
+// matrix, which is applied as the linear map x = L y + shift of the target.
+// The second half of the warmup adapts the step size again on the mapped
+// target. The number of leapfrog steps per draw follows the step size so that
+// every trajectory has the same integration time. As in the other benchmarks
+// the first num_burns of the max_draws iterations are the warmup, and the
+// remaining max_draws - num_burns are kept (and copied to draws if it is not
+// NULL).
+template <typename NT, typename Polytope>
+std::vector<SimulationStats<NT>> benchmark_polytope_sampling_adaptive(
+    Polytope &P,
+    NT integration_time=NT(1),
+    bool dense_metric=false,
+    bool centered=false,
+    unsigned int max_draws=80000,
+    unsigned int num_burns=20000,
+    preprocess_bundle<Polytope> const* bundle=NULL,
+    typename Polytope::MT *draws=NULL) {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef boost::mt19937 RNGType;
+    typedef BoostRandomNumberGenerator<RNGType, NT> RandomNumberGenerator;
+    typedef InnerBallFunctor::GradientFunctor<Point> NegativeGradientFunctor;
+    typedef InnerBallFunctor::FunctionFunctor<Point> NegativeLogprobFunctor;
+    typedef LeapfrogODESolver<Point, NT, Polytope, NegativeGradientFunctor> Solver;
+    typedef PreconditionedFunctor::GradientFunctor<Point, NegativeGradientFunctor,
+                                                   InnerBallFunctor::parameters<NT, Point>> PreconditionedGradientFunctor;
+    typedef PreconditionedFunctor::FunctionFunctor<Point, NegativeLogprobFunctor> PreconditionedLogprobFunctor;
+    typedef LeapfrogODESolver<Point, NT, Polytope, PreconditionedGradientFunctor> PreconditionedSolver;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+
+    SimulationStats<NT> hmc_stats;
+
+    std::pair<Point, NT> inner_ball;
+    if (centered) {
+        inner_ball.first = Point(P.dimension());
+        inner_ball.second = NT(1); // dummy radius (not correct one)
+    } else if (bundle != NULL) {
+        inner_ball = bundle->inner_ball;
+    } else {
+        inner_ball = P.ComputeInnerBall();
+    }
+
+    // Random number generator
+    RandomNumberGenerator rng(1);
+
+    Point x0 = inner_ball.first;
+    NT R0 = inner_ball.second;
+    unsigned int dim = x0.dimension();
+
+    InnerBallFunctor::parameters<NT, Point> params(x0, R0);
+
+    NegativeGradientFunctor F(params);
+    NegativeLogprobFunctor f(params);
+
+    std::cout << "Hamiltonian Monte Carlo (Gaussian Density) with adaptive warmup" << std::endl;
+
+    // Warmup with identity mass matrix
+    HamiltonianMonteCarloWalk::parameters<NT, NegativeGradientFunctor> hmc_params(F, dim);
+    HamiltonianMonteCarloWalk::Walk
+      <Point, Polytope, RandomNumberGenerator, NegativeGradientFunctor, NegativeLogprobFunctor, Solver>
+      hmc(&P, x0, F, f, hmc_params);
+    hmc.disable_adaptive();
+
+    MT warmup_samples(dim, std::max(2u, num_burns / 4));
+    NT eta = hmc_dual_averaging(hmc, rng, integration_time, num_burns / 2, &warmup_samples);
+    std::cout << "Step size (identity metric): " << eta << std::endl;
+
+    // Mass matrix from the warmup samples, regularized towards the identity
+    // as in Stan
+    unsigned int n = warmup_samples.cols();
+    VT shift = warmup_samples.rowwise().mean();
+    MT centered_samples = warmup_samples.colwise() - shift;
+    MT covariance = (centered_samples * centered_samples.transpose()) / NT(n - 1);
+    covariance = (NT(n) / (n + 5)) * covariance + NT(1e-3) * (NT(5) / (n + 5)) * MT::Identity(dim, dim);
+
+    MT L;
+    if (dense_metric) {
+        L = Eigen::LLT<MT>(covariance).matrixL();
+    } else {
+        L = covariance.diagonal().cwiseSqrt().asDiagonal();
+    }
+
+    // Warmup and sampling on y = L^{-1} (x - shift)
+    Polytope Q(P);
+    Q.shift(shift);
+    Q.linear_transformIt(L);
+    // the reflections of the leapfrog solver assume facets with unit normals
+    Q.normalize();
+
+    PreconditionedGradientFunctor G(F, L, shift);
+    PreconditionedLogprobFunctor g(f, L, shift);
+    Point y0(VT(L.template triangularView<Eigen::Lower>().solve(VT(hmc.x.getCoefficients() - shift))));
+
+    HamiltonianMonteCarloWalk::parameters<NT, PreconditionedGradientFunctor> preconditioned_params(G, dim);
+    HamiltonianMonteCarloWalk::Walk
+      <Point, Polytope, RandomNumberGenerator, PreconditionedGradientFunctor, PreconditionedLogprobFunctor, PreconditionedSolver>
+      preconditioned_hmc(&Q, y0, G, g, preconditioned_params);
+    preconditioned_hmc.disable_adaptive();
+
+    eta = hmc_dual_averaging<NT>(preconditioned_hmc, rng, integration_time, num_burns - num_burns / 2,
+                                 (MT*) NULL);
+    unsigned int walk_length = hmc_num_steps(integration_time, eta);
+    std::cout << "Step size (" << (dense_metric ? "dense" : "diagonal") << " metric): " << eta
+              << ", leapfrog steps: " << walk_length << std::endl;
+
+    int max_actual_draws = max_draws - num_burns;
+    unsigned int min_ess = 0;
+    MT samples(dim, max_actual_draws);
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> start, stop;
+
+    std::cout << "Sampling" << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < max_actual_draws; i++) {
+      preconditioned_hmc.apply(rng, walk_length);
+      samples.col(i) = L * preconditioned_hmc.x.getCoefficients() + shift;
+      if (i % 1000 == 0 && i > 0) std::cout << ".";
+    }
+    stop = std::chrono::high_resolution_clock::now();
+
+    NT ETA = (NT) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    std::cout << std::endl;
+    print_diagnostics<NT, VT, MT>(samples, min_ess, std::cout);
+    std::cout << "Average time per sample: " << ETA / max_actual_draws << "us" << std::endl;
+    std::cout << "Average time per independent sample: " << ETA / min_ess << "us" << std::endl;
+    std::cout << "Average number of reflections: " <<
+        (1.0 * preconditioned_hmc.solver->num_reflections) / preconditioned_hmc.solver->num_steps << std::endl;
+    std::cout << "Average Acceptance Probability: " << exp(preconditioned_hmc.average_acceptance_log_prob) << std::endl;
+    std::cout << std::endl;
+
+    NT max_psrf = check_interval_psrf<NT, VT, MT>(samples);
+
+    hmc_stats.method = "HMC (adaptive)";
+    hmc_stats.walk_length = walk_length;
+    hmc_stats.min_ess = min_ess;
+    hmc_stats.max_psrf = max_psrf;
+    hmc_stats.time_per_draw = ETA / max_actual_draws;
+    hmc_stats.time_per_independent_sample = ETA / min_ess;
+    hmc_stats.average_number_of_reflections =
+        (1.0 * preconditioned_hmc.solver->num_reflections) / preconditioned_hmc.solver->num_steps;
+    hmc_stats.step_size = eta;
+    hmc_stats.average_acceptance_log_prob  = exp(preconditioned_hmc.average_acceptance_log_prob);
+
+    if (draws != NULL) {
+        *draws = samples;
+    }
+
+    return std::vector<SimulationStats<NT>>{hmc_stats};
+}
+
+
+// HMC with the trajectory length chosen by the No-U-Turn criterion
+// (Hoffman and Gelman, 2014) in its multinomial form with the generalized
+// U-turn check (Betancourt, 2017). The trajectory is integrated by leapfrog
+// with reflections on the facets of the H-polytope P (P may be NULL), so it
+// also serves truncated densities. Integrating backwards in time is done by
+// flipping the velocity, which keeps the reflective integrator reversible.
+// A, b and the squared row norms of A are copied once, so a leapfrog step does
+// not go through the polytope accessors. The walk keeps a histogram of the tree
+// depths, counts the leapfrog steps, the reflections and the divergent
+// transitions, and sums the log of the acceptance statistic of the transitions.
+template
+<
+    typename Polytope,
+    typename RandomNumberGenerator,
+    typename NegativeGradientFunctor,
+    typename NegativeLogprobFunctor
+>
+struct NoUTurnWalk {
+    typedef typename Polytope::PointType Point;
+    typedef typename Point::FT NT;
+    typedef std::vector<Point> pts;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, 1> VT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, Eigen::Dynamic> MT;
+
+    struct tree {
+        VT x_minus, v_minus, x_plus, v_plus, x_proposal;
+        VT rho;
+        NT log_sum_weight;
+        NT sum_acceptance = NT(0);
+        unsigned int num_leapfrog = 0;
+        bool valid = true;
+    };
+
+    Polytope *P;
+    NegativeGradientFunctor &F;
+    NegativeLogprobFunctor &f;
+    VT x;
+    NT eta;
+    unsigned int max_depth;
+    NT max_energy_error = NT(1000);
+    unsigned int max_reflections = 100;
+
+    MT A;
+    VT b;
+    VT A_row_norms2;
+
+    std::vector<unsigned long long> depth_histogram;
+    unsigned long long num_transitions = 0;
+    unsigned long long num_leapfrog_steps = 0;
+    unsigned long long num_reflections = 0;
+    unsigned long long num_divergent = 0;
+    NT acceptance = NT(0); // average acceptance of the last transition
+    NT total_acceptance_log_prob = NT(0);
+
+    NoUTurnWalk(Polytope *P_, Point const& x0, NegativeGradientFunctor &F_, NegativeLogprobFunctor &f_,
+                NT eta_, unsigned int max_depth_=10) :
+        P(P_), F(F_), f(f_), x(x0.getCoefficients()), eta(eta_), max_depth(max_depth_),
+        depth_histogram(max_depth_ + 1, 0) {
+        if (P != NULL) {
+            A = P->get_mat();
+            b = P->get_vec();
+            A_row_norms2 = A.rowwise().squaredNorm();
+        }
+    }
+
+    // Clears the statistics, e.g. at the end of the burn-in
+    void reset_statistics() {
+        std::fill(depth_histogram.begin(), depth_histogram.end(), 0);
+        num_transitions = 0;
+        num_leapfrog_steps = 0;
+        num_reflections = 0;
+        num_divergent = 0;
+        total_acceptance_log_prob = NT(0);
+    }
+
+    NT hamiltonian(VT const& y, VT const& v) const {
+        return f(Point(y)) + NT(0.5) * v.squaredNorm();
+    }
+
+    VT force(VT const& y, VT const& v) const {
+        return F(F.params.order - 1, pts{Point(y), Point(v)}, NT(0)).getCoefficients();
+    }
+
+    // One leapfrog step forward in time, reflecting on the boundary of P
+    void leapfrog(VT &y, VT &v) {
+        const NT inf = std::numeric_limits<NT>::max();
+        v += (eta / 2) * force(y, v);
+
+        if (P == NULL) {
+            y += eta * v;
+        } else {
+            NT tau = eta;
+            VT slack = b - A * y;
+            for (unsigned int it = 0; it < max_reflections; it++) {
+                VT Av = A * v;
+                VT ratios = slack.cwiseQuotient(Av);
+                int facet;
+                NT lambda = (Av.array() > NT(0)).select(ratios.array(), inf).minCoeff(&facet);
+                if (lambda >= tau) {
+                    y += tau * v;
+                    break;
+                }
+                y += lambda * v;
+                slack -= lambda * Av;
+                tau -= lambda;
+                v -= (NT(2) * Av(facet) / A_row_norms2(facet)) * A.row(facet).transpose();
+                num_reflections++;
+            }
+        }
+
+        v += (eta / 2) * force(y, v);
+        num_leapfrog_steps++;
+    }
+
+    static NT log_sum_exp(NT a, NT b) {
+        NT m = std::max(a, b);
+        return m + std::log(std::exp(a - m) + std::exp(b - m));
+    }
+
+    static bool no_u_turn(VT const& rho, VT const& v_minus, VT const& v_plus) {
+        return rho.dot(v_minus) > NT(0) && rho.dot(v_plus) > NT(0);
+    }
+
+    tree build_tree(VT const& y, VT const& v, unsigned int depth, int direction, NT H0,
+                    RandomNumberGenerator &rng) {
+        tree t;
+        if (depth == 0) {
+            VT y1 = y, v1 = NT(direction) * v;
+            leapfrog(y1, v1);
+            v1 *= NT(direction);
+
+            NT H = hamiltonian(y1, v1);
+            if (std::isnan(H)) H = std::numeric_limits<NT>::infinity();
+            t.x_minus = t.x_plus = t.x_proposal = y1;
+            t.v_minus = t.v_plus = t.rho = v1;
+            t.log_sum_weight = H0 - H;
+            t.sum_acceptance = std::min(NT(1), std::exp(H0 - H));
+            t.num_leapfrog = 1;
+            if (H - H0 > max_energy_error) {
+                t.valid = false;
+                num_divergent++;
+            }
+            return t;
+        }
+
+        tree first = build_tree(y, v, depth - 1, direction, H0, rng);
+        if (!first.valid) return first;
+
+        tree second = direction > 0 ? build_tree(first.x_plus, first.v_plus, depth - 1, direction, H0, rng)
+                                    : build_tree(first.x_minus, first.v_minus, depth - 1, direction, H0, rng);
+        t = first;
+        t.num_leapfrog += second.num_leapfrog;
+        t.sum_acceptance += second.sum_acceptance;
+        if (!second.valid) {
+            t.valid = false;
+            return t;
+        }
+
+        if (direction > 0) {
+            t.x_plus = second.x_plus;
+            t.v_plus = second.v_plus;
+        } else {
+            t.x_minus = second.x_minus;
+            t.v_minus = second.v_minus;
+        }
+        t.log_sum_weight = log_sum_exp(first.log_sum_weight, second.log_sum_weight);
+        if (std::log(rng.sample_urdist()) < second.log_sum_weight - t.log_sum_weight) {
+            t.x_proposal = second.x_proposal;
+        }
+        t.rho = first.rho + second.rho;
+        t.valid = no_u_turn(t.rho, t.v_minus, t.v_plus);
+        return t;
+    }
+
+    void apply(RandomNumberGenerator &rng, unsigned int walk_length=1) {
+        unsigned int dim = x.rows();
+        for (unsigned int j = 0; j < walk_length; j++) {
+            VT v(dim);
+            for (unsigned int i = 0; i < dim; i++) v(i) = rng.sample_ndist();
+            NT H0 = hamiltonian(x, v);
+
+            VT x_minus = x, v_minus = v, x_plus = x, v_plus = v, rho = v, proposal = x;
+            NT log_sum_weight = NT(0), sum_acceptance = NT(0);
+            unsigned int depth = 0, num_leapfrog = 0;
+
+            while (depth < max_depth) {
+                int direction = rng.sample_urdist() < NT(0.5) ? -1 : 1;
+                tree t = direction > 0 ? build_tree(x_plus, v_plus, depth, direction, H0, rng)
+                                       : build_tree(x_minus, v_minus, depth, direction, H0, rng);
+                num_leapfrog += t.num_leapfrog;
+                sum_acceptance += t.sum_acceptance;
+                depth++;
+                if (!t.valid) break;
+
+                if (direction > 0) {
+                    x_plus = t.x_plus;
+                    v_plus = t.v_plus;
+                } else {
+                    x_minus = t.x_minus;
+                    v_minus = t.v_minus;
+                }
+                // biased progressive sampling favours the new subtree
+                if (std::log(rng.sample_urdist()) < t.log_sum_weight - log_sum_weight) {
+                    proposal = t.x_proposal;
+                }
+                log_sum_weight = log_sum_exp(log_sum_weight, t.log_sum_weight);
+                rho += t.rho;
+                if (!no_u_turn(rho, v_minus, v_plus)) break;
+            }
+
+            x = proposal;
+            acceptance = sum_acceptance / num_leapfrog;
+            total_acceptance_log_prob += std::log(acceptance);
+            depth_histogram[depth]++;
+            num_transitions++;
+        }
+    }
+
+    NT average_acceptance_log_prob() const {
+        return total_acceptance_log_prob / num_transitions;
+    }
+
+    NT average_depth() const {
+        NT sum = NT(0);
+        for (unsigned int d = 0; d < depth_histogram.size(); d++) sum += NT(d) * depth_histogram[d];
+        return sum / num_transitions;
+    }
+
+    void print_tree_depths(std::ostream &out) const {
+        out << "Tree depths (depth: fraction):";
+        for (unsigned int d = 0; d < depth_histogram.size(); d++) {
+            if (depth_histogram[d] > 0) out << " " << d << ": " << NT(depth_histogram[d]) / num_transitions;
+        }
+        out << std::endl;
+        out << "Average tree depth: " << average_depth() << std::endl;
+        out << "Average number of leapfrog steps: " << NT(num_leapfrog_steps) / num_transitions << std::endl;
+        out << "Divergent transitions: " << num_divergent << std::endl;
+    }
+};
+
+// NUTS on P for the Gaussian density of InnerBallFunctor. The step size is set
+// by dual averaging during the burn-in; no walk length is needed.
+template <typename NT, typename Polytope>
+std::vector<SimulationStats<NT>> benchmark_polytope_sampling_nuts(
+    Polytope &P,
+    bool centered=false,
+    unsigned int max_depth=10,
+    unsigned int max_draws=80000,
+    unsigned int num_burns=20000,
+    preprocess_bundle<Polytope> const* bundle=NULL) {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef boost::mt19937 RNGType;
+    typedef BoostRandomNumberGenerator<RNGType, NT> RandomNumberGenerator;
+    typedef InnerBallFunctor::GradientFunctor<Point> NegativeGradientFunctor;
+    typedef InnerBallFunctor::FunctionFunctor<Point> NegativeLogprobFunctor;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+
+    SimulationStats<NT> nuts_stats;
+
+    std::pair<Point, NT> inner_ball;
+    if (centered) {
+        inner_ball.first = Point(P.dimension());
+        inner_ball.second = NT(1); // dummy radius (not correct one)
+    } else if (bundle != NULL) {
+        inner_ball = bundle->inner_ball;
+    } else {
+        inner_ball = P.ComputeInnerBall();
+    }
+
+    // Random number generator
+    RandomNumberGenerator rng(1);
+
+    Point x0 = inner_ball.first;
+    NT R0 = inner_ball.second;
+    unsigned int dim = x0.dimension();
+
+    InnerBallFunctor::parameters<NT, Point> params(x0, R0);
+
+    NegativeGradientFunctor F(params);
+    NegativeLogprobFunctor f(params);
+
+    NoUTurnWalk<Polytope, RandomNumberGenerator, NegativeGradientFunctor, NegativeLogprobFunctor>
+      nuts(&P, x0, F, f, R0 / 10, max_depth);
+
+    std::cout << "No-U-Turn Hamiltonian Monte Carlo (Gaussian Density)" << std::endl;
+    std::cout << "Burn-in" << std::endl;
+
+    dual_averaging<NT> adaptation(nuts.eta);
+    for (unsigned int i = 0; i < num_burns; i++) {
+      if (i % 1000 == 0) std::cout << ".";
+      nuts.apply(rng, 1);
+      nuts.eta = adaptation.update(nuts.acceptance);
+    }
+    nuts.eta = adaptation.final_eta();
+
+    std::cout << std::endl;
+    std::cout << "Sampling" << std::endl;
+
+    int max_actual_draws = max_draws - num_burns;
+    unsigned int min_ess = 0;
+    MT samples(dim, max_actual_draws);
+    nuts.reset_statistics();
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> start, stop;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < max_actual_draws; i++) {
+      nuts.apply(rng, 1);
+      samples.col(i) = nuts.x;
+      if (i % 1000 == 0 && i > 0) std::cout << ".";
+    }
+    stop = std::chrono::high_resolution_clock::now();
+
+    NT ETA = (NT) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    std::cout << std::endl;
+    print_diagnostics<NT, VT, MT>(samples, min_ess, std::cout);
+    std::cout << "Average time per sample: " << ETA / max_actual_draws << "us" << std::endl;
+    std::cout << "Average time per independent sample: " << ETA / min_ess << "us" << std::endl;
+    std::cout << "Average number of reflections: " <<
+        (1.0 * nuts.num_reflections) / nuts.num_leapfrog_steps << std::endl;
+    std::cout << "Step size (final): " << nuts.eta << std::endl;
+    std::cout << "Average Acceptance Probability: " << exp(nuts.average_acceptance_log_prob()) << std::endl;
+    nuts.print_tree_depths(std::cout);
+    std::cout << std::endl;
+
+    NT max_psrf = check_interval_psrf<NT, VT, MT>(samples);
+
+    nuts_stats.method = "NUTS";
+    nuts_stats.walk_length = (unsigned int) std::ceil(NT(nuts.num_leapfrog_steps) / max_actual_draws);
+    nuts_stats.min_ess = min_ess;
+    nuts_stats.max_psrf = max_psrf;
+    nuts_stats.time_per_draw = ETA / max_actual_draws;
+    nuts_stats.time_per_independent_sample = ETA / min_ess;
+    nuts_stats.average_number_of_reflections = (1.0 * nuts.num_reflections) / nuts.num_leapfrog_steps;
+    nuts_stats.step_size = nuts.eta;
+    nuts_stats.average_acceptance_log_prob = exp(nuts.average_acceptance_log_prob());
+
+    return std::vector<SimulationStats<NT>>{nuts_stats};
+}
+
+
 template <typename NT, typename Polytope>
 std::vector<SimulationStats<NT>> benchmark_spectrahedron_sampling(
     Polytope &P,
@@ -638,43 +1315,132 @@ std::vector<SimulationStats<NT>> benchmark_spectrahedron_sampling(
 
 
 
+// Runs a batch of independent chains on a fixed number of worker threads.
+// Chain i is dealt to worker i % num_workers. Claiming a chain is one fetch_add
+// on the cursor of the worker that owns it, so a worker that has run out of
+// chains steals from the others with the same operation and no lock is taken;
+// chains of different lengths keep every worker busy until the batch ends.
+// A finished chain appends its index to a completion queue, and the calling
+// thread sleeps on a condition variable until the next index arrives, then
+// hands it to on_done(i, result); the callbacks run in completion order on the
+// calling thread only.
+template <typename Result>
+class chain_pool {
+public:
+    typedef std::function<Result(unsigned int)> Chain;
+
+    explicit chain_pool(unsigned int num_workers = 0)
+        : _num_workers(num_workers > 0 ? num_workers
+                                       : std::max(1u, std::thread::hardware_concurrency())) {}
+
+    unsigned int num_workers() const {
+        return _num_workers;
+    }
+
+    template <typename Callback>
+    std::vector<Result> run(std::vector<Chain> const& chains, Callback on_done) {
+        unsigned int n = chains.size();
+        unsigned int W = std::min(_num_workers, std::max(1u, n));
+        std::vector<Result> results(n);
+        std::unique_ptr<padded_cursor[]> cursors(new padded_cursor[W]);
+        std::vector<unsigned int> done;
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+
+        done.reserve(n);
+        for (unsigned int w = 0; w < W; w++) cursors[w].next.store(0);
+
+        auto worker = [&](unsigned int w) {
+            for (unsigned int k = 0; k < W; k++) {
+                unsigned int owner = (w + k) % W;
+                while (true) {
+                    unsigned int i = owner + W * cursors[owner].next.fetch_add(1);
+                    if (i >= n) break;
+                    results[i] = chains[i](i);
+                    {
+                        std::lock_guard<std::mutex> lock(done_mutex);
+                        done.push_back(i);
+                    }
+                    done_cv.notify_one();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < W; w++) workers.emplace_back(worker, w);
+
+        for (unsigned int slot = 0; slot < n; slot++) {
+            unsigned int i;
+            {
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done_cv.wait(lock, [&] { return done.size() > slot; });
+                i = done[slot];
+            }
+            on_done(i, results[i]);
+        }
+
+        for (std::thread &t : workers) t.join();
+        return results;
+    }
+
+    std::vector<Result> run(std::vector<Chain> const& chains) {
+        return run(chains, [](unsigned int, Result const&) {});
+    }
+
+private:
+    // one cursor per cache line, so that the workers do not share cache lines
+    struct padded_cursor {
+        std::atomic<unsigned int> next;
+        char padding[64 - sizeof(std::atomic<unsigned int>)];
+    };
+
+    unsigned int _num_workers;
+};
+
+
+// Runs one HMC chain per (step size, walk length) pair on a chain_pool. The
+// polytope is preprocessed (inner ball and optional rounding) once and shared
+// read-only by all the chains, without a cache file. Every chain writes its
+// log to its own buffer, which is printed with the chain's stats when the
+// chain finishes, so the logs of concurrent chains are not interleaved.
 template <typename NT, typename Polytope>
-void benchmark_multi_chain(
-    unsigned int num_chains,
+std::vector<std::vector<SimulationStats<NT>>> benchmark_multi_chain(
+    std::vector<std::pair<NT, unsigned int>> const& chain_params,
     Polytope &P,
-    NT eta=NT(-1),
-    unsigned int walk_length=3,
     bool rounding=true,
     unsigned int max_draws=80000,
-    unsigned int num_burns=20000) {
-    typedef Cartesian<NT>    Kernel;
-    typedef typename Kernel::Point    Point;
-    typedef std::vector<Point> pts;
+    unsigned int num_burns=20000,
+    unsigned int num_workers=0) {
     typedef boost::mt19937 RNGType;
     typedef BoostRandomNumberGenerator<RNGType, NT> RandomNumberGenerator;
-    typedef typename Polytope::MT MT;
-    typedef typename Polytope::VT VT;
-
-    std::pair<Point, NT> inner_ball = P.ComputeInnerBall();
+    typedef std::vector<SimulationStats<NT>> Result;
 
     // Random number generator
     RandomNumberGenerator rng(1);
 
-    // Chebyshev center
-    Point x0 = inner_ball.first;
-    NT R0 = inner_ball.second;
-    unsigned int dim = x0.dimension();
-
-    if (rounding) {
-        std::cout << "SVD Rounding" << std::endl;
-        svd_rounding<AcceleratedBilliardWalk, MT, VT>(P, inner_ball, walk_length, rng);
-    }
-
-    for (unsigned int i = 0; i < num_chains; i++) {
-        std::thread chain(benchmark_polytope_sampling<NT, Polytope>, P, eta, walk_length, false, max_draws, num_burns, num_chains);
-        chain.join();
+    preprocess_bundle<Polytope> bundle = preprocess(P, rounding, 1, rng);
+
+    std::vector<std::string> logs(chain_params.size());
+    std::vector<typename chain_pool<Result>::Chain> chains;
+    for (std::pair<NT, unsigned int> const& params : chain_params) {
+        chains.push_back([&P, &bundle, &logs, params, max_draws, num_burns](unsigned int i) {
+            std::ostringstream log;
+            Result stats = benchmark_polytope_sampling<NT, Polytope>(P, params.first, params.second, false, false,
+                                                                     false, max_draws, num_burns, &bundle, log);
+            logs[i] = log.str();
+            return stats;
+        });
     }
 
+    chain_pool<Result> pool(num_workers);
+    std::cout << "Running " << chains.size() << " chains on " << pool.num_workers()
+              << " workers" << std::endl;
+    return pool.run(chains, [&chain_params, &logs](unsigned int i, Result const& stats) {
+        std::cout << logs[i];
+        std::cout << "chain " << i << " (eta = " << chain_params[i].first
+                  << ", walk length = " << chain_params[i].second << ") finished" << std::endl;
+        std::cout << stats[1];
+    });
 }
 
 template <typename NT, typename Polytope, typename Point>
@@ -825,6 +1591,318 @@ Polytope read_polytope(std::string filename) {
     return P;
 }
 
+// Binary polytope format
+//
+// A fixed size header followed by the raw column-major matrix A (rows x cols),
+// the vector b (rows), then optionally the inner ball center (cols) and radius
+// and the rounding transform T (cols x cols) with its shift (cols). The file is
+// memory-mapped when read, so A, b and the optional parts are Eigen::Map views
+// on the mapped pages and nothing is parsed. Constructing a polytope from the
+// map still copies A and b once into the polytope's own matrices.
+// A file converted from an .ine stores the size and modification time of the
+// .ine, and load_polytope rebuilds it when they no longer match.
+enum polytope_binary_type {
+    H_POLYTOPE_BINARY = 0,
+    V_POLYTOPE_BINARY = 1,
+    ZONOTOPE_BINARY = 2
+};
+
+struct polytope_binary_header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t type;
+    std::uint32_t scalar_size;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+};
+
+const std::uint32_t POLYTOPE_BINARY_VERSION = 2;
+const std::uint32_t POLYTOPE_BINARY_INNER_BALL = 1;
+const std::uint32_t POLYTOPE_BINARY_TRANSFORM = 2;
+
+// Size and modification time of the source file, (0, 0) if it cannot be read
+inline std::pair<std::uint64_t, std::int64_t> polytope_source_stamp(std::string const& filename) {
+    struct stat st;
+    if (filename.empty() || stat(filename.c_str(), &st) != 0) {
+        return std::make_pair(std::uint64_t(0), std::int64_t(0));
+    }
+    return std::make_pair(std::uint64_t(st.st_size), std::int64_t(st.st_mtime));
+}
+
+// The file is written to filename + ".tmp" and renamed over filename, so a crash
+// or a concurrent reader never sees a truncated file (whose size and mtime could
+// still match the source). Returns false, and removes the temporary file, if
+// any write fails
+template <typename Polytope>
+bool write_polytope_binary(std::string const& filename,
+                           Polytope &P,
+                           polytope_binary_type type,
+                           std::pair<typename Polytope::PointType, typename Polytope::NT> const* inner_ball = NULL,
+                           std::pair<typename Polytope::MT, typename Polytope::VT> const* transform = NULL,
+                           std::string const& source_filename = "")
+{
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+
+    MT A = P.get_mat();
+    VT b = P.get_vec();
+
+    polytope_binary_header header;
+    std::memcpy(header.magic, "VPLB", 4);
+    header.version = POLYTOPE_BINARY_VERSION;
+    header.type = type;
+    header.scalar_size = sizeof(NT);
+    header.rows = A.rows();
+    header.cols = A.cols();
+    header.flags = (inner_ball != NULL ? POLYTOPE_BINARY_INNER_BALL : 0)
+                 | (transform != NULL ? POLYTOPE_BINARY_TRANSFORM : 0);
+    header.reserved = 0;
+    std::pair<std::uint64_t, std::int64_t> stamp = polytope_source_stamp(source_filename);
+    header.source_size = stamp.first;
+    header.source_mtime = stamp.second;
+
+    std::string tmp_filename = filename + ".tmp";
+    std::ofstream out(tmp_filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(A.data()), sizeof(NT) * A.size());
+    out.write(reinterpret_cast<const char*>(b.data()), sizeof(NT) * b.size());
+    if (inner_ball != NULL) {
+        VT center = inner_ball->first.getCoefficients();
+        out.write(reinterpret_cast<const char*>(center.data()), sizeof(NT) * center.size());
+        out.write(reinterpret_cast<const char*>(&inner_ball->second), sizeof(NT));
+    }
+    if (transform != NULL) {
+        out.write(reinterpret_cast<const char*>(transform->first.data()),
+                  sizeof(NT) * transform->first.size());
+        out.write(reinterpret_cast<const char*>(transform->second.data()),
+                  sizeof(NT) * transform->second.size());
+    }
+    out.flush();
+    bool written = out.good();
+    out.close();
+    if (!written || out.fail()
+        || std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Failed to write binary polytope file " << filename << std::endl;
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename NT>
+class polytope_binary_map {
+public:
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, 1> VT;
+
+    polytope_binary_map(std::string const& filename,
+                        polytope_binary_type type = H_POLYTOPE_BINARY)
+        : A(NULL, 0, 0), b(NULL, 0), center(NULL, 0), T(NULL, 0, 0), T_shift(NULL, 0),
+          radius(0), _data(NULL), _size(0), _valid(false)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(polytope_binary_header)) {
+            _size = st.st_size;
+            void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) _data = static_cast<const char*>(data);
+        }
+        close(fd);
+        if (_data == NULL) return;
+
+        std::memcpy(&header, _data, sizeof(header));
+        if (std::memcmp(header.magic, "VPLB", 4) != 0
+            || header.version != POLYTOPE_BINARY_VERSION
+            || header.type != std::uint32_t(type)
+            || header.scalar_size != sizeof(NT)) {
+            std::cerr << "Invalid binary polytope file " << filename << std::endl;
+            return;
+        }
+
+        std::size_t m = header.rows, d = header.cols;
+        std::size_t expected = m * d + m
+            + ((header.flags & POLYTOPE_BINARY_INNER_BALL) ? d + 1 : 0)
+            + ((header.flags & POLYTOPE_BINARY_TRANSFORM) ? d * d + d : 0);
+        if (_size < sizeof(header) + sizeof(NT) * expected) {
+            std::cerr << "Truncated binary polytope file " << filename << std::endl;
+            return;
+        }
+
+        const NT* ptr = reinterpret_cast<const NT*>(_data + sizeof(header));
+        new (&A) Eigen::Map<const MT>(ptr, m, d);
+        ptr += m * d;
+        new (&b) Eigen::Map<const VT>(ptr, m);
+        ptr += m;
+        if (header.flags & POLYTOPE_BINARY_INNER_BALL) {
+            new (&center) Eigen::Map<const VT>(ptr, d);
+            ptr += d;
+            radius = *ptr;
+            ptr++;
+        }
+        if (header.flags & POLYTOPE_BINARY_TRANSFORM) {
+            new (&T) Eigen::Map<const MT>(ptr, d, d);
+            ptr += d * d;
+            new (&T_shift) Eigen::Map<const VT>(ptr, d);
+        }
+        _valid = true;
+    }
+
+    ~polytope_binary_map()
+    {
+        if (_data != NULL) munmap(const_cast<char*>(_data), _size);
+    }
+
+    bool is_open() const { return _valid; }
+    bool has_inner_ball() const { return _valid && (header.flags & POLYTOPE_BINARY_INNER_BALL); }
+    bool has_transform() const { return _valid && (header.flags & POLYTOPE_BINARY_TRANSFORM); }
+    unsigned int dimension() const { return header.cols; }
+
+    polytope_binary_header header;
+    Eigen::Map<const MT> A;
+    Eigen::Map<const VT> b;
+    Eigen::Map<const VT> center;
+    Eigen::Map<const MT> T;
+    Eigen::Map<const VT> T_shift;
+    NT radius;
+
+private:
+    polytope_binary_map(polytope_binary_map const&);
+    polytope_binary_map& operator=(polytope_binary_map const&);
+
+    const char* _data;
+    std::size_t _size;
+    bool _valid;
+};
+
+template <typename Polytope, typename NT>
+Polytope read_polytope_binary(std::string filename,
+                              polytope_binary_type type = H_POLYTOPE_BINARY) {
+    polytope_binary_map<NT> bin(filename, type);
+    if (!bin.is_open()) return Polytope();
+    Polytope P(bin.dimension(), bin.A, bin.b);
+    return P;
+}
+
+// Converts an .ine file to the binary format
+template <typename Polytope, typename NT>
+void convert_ine_to_binary(std::string ine_filename, std::string bin_filename) {
+    Polytope P = read_polytope<Polytope, NT>(ine_filename);
+    write_polytope_binary(bin_filename, P, H_POLYTOPE_BINARY, NULL, NULL, ine_filename);
+}
+
+// Loads an .ine polytope from its binary sibling (filename + ".bin") and
+// creates the binary file on the first load. The binary file is used only if
+// it was converted from the current .ine (same size and modification time),
+// otherwise the .ine is parsed again and the binary file is rewritten.
+template <typename Polytope, typename NT>
+Polytope load_polytope(std::string filename) {
+    std::string bin_filename = filename + ".bin";
+    std::pair<std::uint64_t, std::int64_t> stamp = polytope_source_stamp(filename);
+    polytope_binary_map<NT> bin(bin_filename);
+    if (bin.is_open() && stamp.first > 0
+        && bin.header.source_size == stamp.first
+        && bin.header.source_mtime == stamp.second) {
+        Polytope P(bin.dimension(), bin.A, bin.b);
+        return P;
+    }
+    Polytope P = read_polytope<Polytope, NT>(filename);
+    if (P.num_of_hyperplanes() > 0) {
+        write_polytope_binary(bin_filename, P, H_POLYTOPE_BINARY, NULL, NULL, filename);
+    }
+    return P;
+}
+
+// FNV-1a hash of the dimensions and the raw entries of (A, b)
+template <typename MT, typename VT>
+std::uint64_t polytope_content_hash(MT const& A, VT const& b) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto update = [&hash](const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    std::uint64_t rows = A.rows(), cols = A.cols();
+    update(&rows, sizeof(rows));
+    update(&cols, sizeof(cols));
+    update(A.data(), sizeof(typename MT::Scalar) * A.size());
+    update(b.data(), sizeof(typename VT::Scalar) * b.size());
+    return hash;
+}
+
+// Computes the inner ball and, if rounding is true, the SVD rounding of P and
+// leaves P preprocessed (rounded, with normalized rows). If cache_dir is not
+// empty, the result is stored there in the binary polytope format (original A,
+// b, inner ball and transform) under the hash of (A, b). A later call on the
+// same polytope maps that file, checks that A and b match and applies the
+// stored transform and the row normalization, without solving the inner ball
+// LP or running the rounding walk. An empty cache_dir neither reads nor writes
+// a cache file.
+template <typename Polytope, typename RandomNumberGenerator>
+preprocess_bundle<Polytope> preprocess(Polytope &P,
+                                       bool rounding,
+                                       unsigned int walk_length,
+                                       RandomNumberGenerator &rng,
+                                       std::string const& cache_dir = "") {
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::MT MT;
+    typedef typename Polytope::VT VT;
+
+    preprocess_bundle<Polytope> bundle;
+    Polytope P0(P);
+    bundle.key = polytope_content_hash(P0.get_mat(), P0.get_vec());
+
+    std::string filename = preprocess_cache_filename(cache_dir, bundle.key, rounding);
+
+    if (!cache_dir.empty()) {
+        polytope_binary_map<NT> bin(filename);
+        if (bin.has_inner_ball() && rounding == bin.has_transform()
+            && bin.A == P0.get_mat() && bin.b == P0.get_vec()) {
+            bundle.from_cache = true;
+            bundle.inner_ball.first = typename Polytope::PointType(VT(bin.center));
+            bundle.inner_ball.second = bin.radius;
+            if (bin.has_transform()) {
+                bundle.rounded = true;
+                bundle.T = bin.T;
+                bundle.T_shift = bin.T_shift;
+                bundle.log_det = bundle.T.partialPivLu().matrixLU().diagonal()
+                                     .cwiseAbs().array().log().sum();
+                P.shift(bundle.T_shift);
+                P.linear_transformIt(bundle.T);
+            }
+            // the inner ball LP and the rounding leave the rows of P normalized
+            P.normalize();
+            return bundle;
+        }
+    }
+
+    bundle.inner_ball = P.ComputeInnerBall();
+    if (rounding) {
+        std::tuple<MT, VT, NT> res = svd_rounding<AcceleratedBilliardWalk, MT, VT>(P, bundle.inner_ball,
+                                                                                  walk_length, rng);
+        bundle.rounded = true;
+        bundle.T = std::get<0>(res);
+        bundle.T_shift = std::get<1>(res);
+        bundle.log_det = std::log(std::get<2>(res));
+        bundle.inner_ball = P.ComputeInnerBall();
+    }
+
+    if (!cache_dir.empty()) {
+        std::pair<MT, VT> transform = std::make_pair(bundle.T, bundle.T_shift);
+        write_polytope_binary(filename, P0, H_POLYTOPE_BINARY, &bundle.inner_ball,
+                              rounding ? &transform : NULL);
+    }
+    return bundle;
+}
+
 template <typename NT, typename Point>
 Point read_linear_objective(std::string filename) {
     std::ifstream inp;
@@ -880,17 +1958,17 @@ void call_test_benchmark_polytopes_grid_search() {
        std::make_tuple(generate_cube<Hpolytope>(100, false), "100_cube", false),
        std::make_tuple(generate_prod_simplex<Hpolytope>(50, false), "50_prod_simplex", false),
        std::make_tuple(generate_birkhoff<Hpolytope>(10), "10_birkhoff", false),
-       std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_iAB_RBC_283.ine"), "iAB_RBC_283", true),
-       std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_iAT_PLT_636.ine"), "iAT_PLT_636", true),
-       std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_e_coli.ine"), "e_coli", true),
-       std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_recon2.ine"), "recon2", true)
+       std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_iAB_RBC_283.ine"), "iAB_RBC_283", true),
+       std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_iAT_PLT_636.ine"), "iAT_PLT_636", true),
+       std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_e_coli.ine"), "e_coli", true),
+       std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_recon2.ine"), "recon2", true)
     };
 
     Hpolytope P;
     std::string name;
     std::ofstream outfile;
-    NT step_size = 0;
-    std::pair<Point, NT> inner_ball;
+    preprocess_bundle<Hpolytope> bundle;
+    BoostRandomNumberGenerator<RNGType, NT> rng(1);
 
     for (std::tuple<Hpolytope, std::string, bool> polytope_tuple : polytopes) {
         P = std::get<0>(polytope_tuple);
@@ -898,19 +1976,222 @@ void call_test_benchmark_polytopes_grid_search() {
         std::cout << name << std::endl;
         outfile.open("results_" + name + "_new.txt");
         P.normalize();
-        inner_ball = P.ComputeInnerBall();
-        step_size = inner_ball.second / 10;
-        for (unsigned int walk_length = 500; walk_length <= P.dimension(); walk_length += P.dimension() / 10) {
-            results = benchmark_polytope_sampling<NT, Hpolytope>(P, step_size, walk_length, false, std::get<2>(polytope_tuple), false);
-            outfile << results[0];
-            outfile << results[1];
-        }
+        bundle = preprocess(P, false, 1, rng);
+        results = benchmark_polytope_sampling_adaptive<NT, Hpolytope>(P, NT(1), false, std::get<2>(polytope_tuple),
+                                                                      80000, 20000, &bundle);
+        outfile << results[0];
         outfile.close();
     }
 
 }
 
 
+template <typename NT>
+void call_test_binary_polytope_format() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef VPolytope<Point> Vpolytope;
+    typedef typename Hpolytope::MT MT;
+    typedef typename Hpolytope::VT VT;
+
+    std::cout << "--- Testing binary polytope format" << std::endl;
+
+    Hpolytope P = generate_cube<Hpolytope>(10, false);
+    std::pair<Point, NT> inner_ball = P.ComputeInnerBall();
+    std::pair<MT, VT> transform = std::make_pair(MT(NT(2) * MT::Identity(10, 10)), VT(VT::Ones(10)));
+    CHECK(write_polytope_binary("cube10.bin", P, H_POLYTOPE_BINARY, &inner_ball, &transform));
+
+    {
+        polytope_binary_map<NT> bin("cube10.bin");
+        CHECK(bin.is_open());
+        CHECK(bin.has_inner_ball());
+        CHECK(bin.has_transform());
+        CHECK(bin.A == P.get_mat());
+        CHECK(bin.b == P.get_vec());
+        CHECK(bin.center == inner_ball.first.getCoefficients());
+        CHECK(bin.radius == inner_ball.second);
+        CHECK(bin.T == transform.first);
+        CHECK(bin.T_shift == transform.second);
+    }
+
+    Hpolytope Q = read_polytope_binary<Hpolytope, NT>("cube10.bin");
+    CHECK(Q.dimension() == P.dimension());
+    CHECK(Q.get_mat() == P.get_mat());
+    CHECK(Q.get_vec() == P.get_vec());
+
+    Vpolytope V = generate_cube<Vpolytope>(5, true);
+    CHECK(write_polytope_binary("cube5_v.bin", V, V_POLYTOPE_BINARY));
+    Vpolytope W = read_polytope_binary<Vpolytope, NT>("cube5_v.bin", V_POLYTOPE_BINARY);
+    CHECK(W.get_mat() == V.get_mat());
+
+    // a file of another type is rejected
+    polytope_binary_map<NT> wrong_type("cube5_v.bin", H_POLYTOPE_BINARY);
+    CHECK(!wrong_type.is_open());
+
+    // the file is renamed into place, and a failed write is reported and
+    // leaves no file behind
+    CHECK(!std::ifstream("cube10.bin.tmp").good());
+    CHECK(!write_polytope_binary("no_such_dir/cube10.bin", P, H_POLYTOPE_BINARY));
+
+    // the cached binary of an .ine is rebuilt when the .ine changes (here
+    // its size changes, as both writes may fall in the same second)
+    std::ofstream ine("cube2.ine");
+    ine << "H-representation\nbegin\n 4 3 real\n 1 1 0\n 1 -1 0\n 1 0 1\n 1 0 -1\nend\n";
+    ine.close();
+    Hpolytope C = load_polytope<Hpolytope, NT>("cube2.ine");
+    CHECK(C.get_vec() == VT::Ones(4));
+    ine.open("cube2.ine");
+    ine << "H-representation\nbegin\n 4 3 real\n 2.5 1 0\n 2.5 -1 0\n 2.5 0 1\n 2.5 0 -1\nend\n";
+    ine.close();
+    C = load_polytope<Hpolytope, NT>("cube2.ine");
+    CHECK(C.get_vec() == VT::Constant(4, NT(2.5)));
+
+    std::remove("cube10.bin");
+    std::remove("cube5_v.bin");
+    std::remove("cube2.ine");
+    std::remove("cube2.ine.bin");
+}
+
+template <typename NT>
+void call_test_preprocess_bundle() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    std::cout << "--- Testing cached preprocessing on H-skinny_cube10" << std::endl;
+
+    Hpolytope P0 = generate_skinny_cube<Hpolytope>(10, false);
+    RNGType rng(P0.dimension());
+
+    char cache_dir[] = "/tmp/volesti_preprocess_XXXXXX";
+    CHECK(mkdtemp(cache_dir) != NULL);
+
+    Hpolytope P1(P0);
+    preprocess_bundle<Hpolytope> bundle1 = preprocess(P1, true, 1, rng, cache_dir);
+    CHECK(!bundle1.from_cache);
+    CHECK(bundle1.rounded);
+
+    Hpolytope P2(P0);
+    preprocess_bundle<Hpolytope> bundle2 = preprocess(P2, true, 1, rng, cache_dir);
+    CHECK(bundle2.from_cache);
+    CHECK(bundle2.key == bundle1.key);
+    CHECK(bundle2.T == bundle1.T);
+    CHECK(bundle2.T_shift == bundle1.T_shift);
+    CHECK(std::abs(bundle2.log_det - bundle1.log_det) < 1e-8);
+    CHECK(bundle2.inner_ball.second == bundle1.inner_ball.second);
+    CHECK((P2.get_mat() - P1.get_mat()).norm() < 1e-10);
+    CHECK((P2.get_vec() - P1.get_vec()).norm() < 1e-10);
+    CHECK((P2.get_mat().rowwise().norm().array() - NT(1)).abs().maxCoeff() < 1e-10);
+
+    // without a cache directory nothing is read or written
+    Hpolytope P3(P0);
+    preprocess_bundle<Hpolytope> bundle3 = preprocess(P3, true, 1, rng);
+    CHECK(!bundle3.from_cache);
+
+    std::remove(preprocess_cache_filename(cache_dir, bundle1.key, true).c_str());
+    rmdir(cache_dir);
+}
+
+template <typename NT>
+void call_test_hmc_adaptive_warmup() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+
+    std::cout << "--- Testing HMC with adaptive warmup on H-skinny_cube10" << std::endl;
+
+    Hpolytope P = generate_skinny_cube<Hpolytope>(10, false);
+    std::vector<SimulationStats<NT>> results;
+    typename Hpolytope::MT draws;
+
+    // 2000 warmup iterations and 15000 draws, which are mapped back to P
+    for (bool dense_metric : {false, true}) {
+        results = benchmark_polytope_sampling_adaptive<NT, Hpolytope>(P, NT(1), dense_metric, false,
+                                                                      17000, 2000, NULL, &draws);
+        std::cout << results[0];
+        NT violation = ((P.get_mat() * draws).colwise() - P.get_vec()).maxCoeff();
+        std::cout << "max constraint violation = " << violation << std::endl;
+        CHECK(results[0].step_size > NT(0));
+        CHECK(results[0].max_psrf < NT(1.1));
+        CHECK(violation < NT(1e-8));
+    }
+}
+
+template <typename NT>
+void call_test_nuts() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+
+    std::vector<std::tuple<Hpolytope, std::string>> polytopes{
+        std::make_tuple(generate_cube<Hpolytope>(10, false), "H-cube10"),
+        std::make_tuple(generate_skinny_cube<Hpolytope>(10, false), "H-skinny_cube10")
+    };
+
+    for (std::tuple<Hpolytope, std::string> polytope_tuple : polytopes) {
+        std::cout << "--- Testing NUTS on " << std::get<1>(polytope_tuple) << std::endl;
+        Hpolytope P = std::get<0>(polytope_tuple);
+        std::vector<SimulationStats<NT>> results =
+            benchmark_polytope_sampling_nuts<NT, Hpolytope>(P, false, 10, 20000, 5000);
+        std::cout << results[0];
+        CHECK(results[0].min_ess > 0);
+        CHECK(results[0].max_psrf < NT(1.1));
+        CHECK(results[0].average_acceptance_log_prob > NT(0.5));
+    }
+}
+
+template <typename NT>
+void call_test_chain_pool() {
+    std::cout << "--- Testing chain pool with chains of different lengths" << std::endl;
+
+    unsigned int num_chains = 32;
+    std::vector<std::function<NT(unsigned int)>> chains;
+    for (unsigned int i = 0; i < num_chains; i++) {
+        chains.push_back([](unsigned int i) {
+            // chains of very different lengths
+            std::this_thread::sleep_for(std::chrono::milliseconds(i % 4 == 0 ? 40 : 2));
+            return NT(i) * NT(i);
+        });
+    }
+
+    chain_pool<NT> pool(4);
+    std::vector<unsigned int> times_done(num_chains, 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<NT> results = pool.run(chains, [&times_done](unsigned int i, NT const&) {
+        times_done[i]++;
+    });
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    std::cout << "ETA (ms): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << std::endl;
+
+    for (unsigned int i = 0; i < num_chains; i++) {
+        CHECK(times_done[i] == 1);
+        CHECK(results[i] == NT(i) * NT(i));
+    }
+}
+
+template <typename NT>
+void call_test_benchmark_multi_chain() {
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+
+    std::cout << "--- Multi-chain HMC on H-skinny_cube10" << std::endl;
+
+    Hpolytope P = generate_skinny_cube<Hpolytope>(10, false);
+    std::vector<std::pair<NT, unsigned int>> chain_params{
+        std::make_pair(NT(0.1), 1u), std::make_pair(NT(0.05), 3u),
+        std::make_pair(NT(0.1), 5u), std::make_pair(NT(0.02), 10u)
+    };
+
+    std::vector<std::vector<SimulationStats<NT>>> results =
+        benchmark_multi_chain<NT, Hpolytope>(chain_params, P, true, 20000, 5000);
+    CHECK(results.size() == chain_params.size());
+}
+
 template <typename NT>
 void call_test_benchmark_spectrahedra_grid_search() {
 
@@ -1023,17 +2304,17 @@ void call_test_exp_sampling() {
     
     if (exists_check("metabolic_full_dim/e_coli_biomass_function.txt") && exists_check("metabolic_full_dim/polytope_e_coli.ine")){
       Point biomass_function_e_coli = load_biomass_function<Point, NT>("metabolic_full_dim/e_coli_biomass_function.txt");
-      polytopes.push_back(std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_e_coli.ine"), biomass_function_e_coli, "e_coli", true));
+      polytopes.push_back(std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_e_coli.ine"), biomass_function_e_coli, "e_coli", true));
     }
 
     if (exists_check("metabolic_full_dim/iAT_PTL_636_biomass_function.txt") && exists_check("metabolic_full_dim/polytope_iAT_PTL_636.ine")){
       Point biomass_function_iAT = load_biomass_function<Point, NT>("metabolic_full_dim/iAT_PTL_636_biomass_function.txt");
-      polytopes.push_back(std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_iAT_PTL_636.ine"), biomass_function_iAT, "iAT_PTL_636", true));
+      polytopes.push_back(std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_iAT_PTL_636.ine"), biomass_function_iAT, "iAT_PTL_636", true));
     }
 
     if (exists_check("metabolic_full_dim/recon1_function.txt") && exists_check("metabolic_full_dim/polytope_recon1.ine")){
       Point biomass_function_recon1 = load_biomass_function<Point, NT>("metabolic_full_dim/recon1_biomass_function.txt");
-      polytopes.push_back(std::make_tuple(read_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_recon1.ine"), biomass_function_recon1, "recon1", true));
+      polytopes.push_back(std::make_tuple(load_polytope<Hpolytope, NT>("metabolic_full_dim/polytope_recon1.ine"), biomass_function_recon1, "recon1", true));
     }
 
     Hpolytope P;
@@ -1180,6 +2461,26 @@ TEST_CASE("exponential_biomass_sampling") {
     call_test_exp_sampling<double>();
 }
 
+TEST_CASE("binary_polytope_format") {
+    call_test_binary_polytope_format<double>();
+}
+
+TEST_CASE("preprocess_bundle") {
+    call_test_preprocess_bundle<double>();
+}
+
+TEST_CASE("hmc_adaptive_warmup") {
+    call_test_hmc_adaptive_warmup<double>();
+}
+
+TEST_CASE("nuts") {
+    call_test_nuts<double>();
+}
+
+TEST_CASE("chain_pool") {
+    call_test_chain_pool<double>();
+}
+
 TEST_CASE("benchmark_hmc") {
     call_test_benchmark_hmc<double>(false);
 }
@@ -1196,6 +2497,10 @@ TEST_CASE("benchmark_convex_body") {
     call_test_benchmark_convex_body<double>();
 }
 
+TEST_CASE("benchmark_multi_chain") {
+    call_test_benchmark_multi_chain<double>();
+}
+
 TEST_CASE("benchmark_spectrahedra_grid_search") {
     call_test_benchmark_spectrahedra_grid_search<double>();
 }
@@ -0,0 +1,745 @@
+#include <chrono>
+#include "doctest.h"
+#include "diagnostics/univariate_psrf.hpp"
+#include "Eigen/Eigen"
+#include "Eigen/Sparse"
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "known_polytope_generators.h"
+#include "misc.h"
+#include "random.hpp"
+#include "random/uniform_int.hpp"
+#include "random/normal_distribution.hpp"
+#include "random/uniform_real_distribution.hpp"
+#include "random_walks/random_walks.hpp"
+#include "preprocess/svd_rounding.hpp"
+#include <string>
+#include <tuple>
+#include <vector>
+
+
+// H-polytope {x : A T x <= b} with A stored in compressed sparse form, once
+// by columns and once by rows, and the transform T kept apart as a sparse
+// matrix (there is no T until linear_transformIt is called). A product with
+// A T is two sparse products, so rounding does not fill A in. When A T is not
+// denser than A and T together, e.g. for a diagonal or permutation T, it is
+// folded into A and T is dropped. The boundary oracles match the ones of
+// HPolytope, including the overloads that cache A r, A v or the slack
+// b - A r between calls; the inner ball is delegated to HPolytope on the
+// dense matrix, which is formed only for that call.
+template <typename Point>
+class SparseHPolytope
+{
+public:
+    typedef Point PointType;
+    typedef typename Point::FT NT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, 1> VT;
+    typedef Eigen::SparseMatrix<NT> SpMT;
+    typedef Eigen::SparseMatrix<NT, Eigen::RowMajor> RowSpMT;
+    typedef Eigen::SparseVector<NT> SpVT;
+
+    SparseHPolytope() : _d(0), _transformed(false) {}
+
+    SparseHPolytope(unsigned int d, SpMT const& A, VT const& b)
+        : _d(d), _A(A), _A_rows(A), _b(b), _transformed(false)
+    {
+        _A.makeCompressed();
+        _A_rows.makeCompressed();
+    }
+
+    template <typename Polytope>
+    explicit SparseHPolytope(Polytope const& P)
+        : _d(P.dimension()), _A(P.get_mat().sparseView()), _b(P.get_vec()), _transformed(false)
+    {
+        _A.makeCompressed();
+        _A_rows = _A;
+        _A_rows.makeCompressed();
+    }
+
+    unsigned int dimension() const
+    {
+        return _d;
+    }
+
+    unsigned int num_of_hyperplanes() const
+    {
+        return _A.rows();
+    }
+
+    SpMT const& get_sparse_mat() const
+    {
+        return _A;
+    }
+
+    VT const& get_vec() const
+    {
+        return _b;
+    }
+
+    bool has_transform() const
+    {
+        return _transformed;
+    }
+
+    // dense A T, for inspection and for the inner ball LP
+    MT get_mat() const
+    {
+        return _transformed ? MT(_A * _T) : MT(_A);
+    }
+
+    std::size_t memory_bytes() const
+    {
+        typedef typename SpMT::StorageIndex Index;
+        return 2 * _A.nonZeros() * (sizeof(NT) + sizeof(Index))
+               + (_A.cols() + _A_rows.rows() + 2) * sizeof(Index)
+               + _b.size() * sizeof(NT)
+               + _T.nonZeros() * (sizeof(NT) + sizeof(Index)) + (_T.cols() + 1) * sizeof(Index);
+    }
+
+    // A T v
+    VT multiply(VT const& v) const
+    {
+        return _transformed ? VT(_A * VT(_T * v)) : VT(_A * v);
+    }
+
+    // i-th row of A T
+    VT row(unsigned int i) const
+    {
+        if (_transformed)
+        {
+            return VT((_A_rows.row(i) * _T).transpose());
+        }
+        VT a = VT::Zero(_d);
+        for (typename RowSpMT::InnerIterator it(_A_rows, i); it; ++it)
+        {
+            a(it.col()) = it.value();
+        }
+        return a;
+    }
+
+    // i-th column of A T
+    SpVT column(unsigned int i) const
+    {
+        return _transformed ? SpVT(_A * _T.col(i)) : SpVT(_A.col(i));
+    }
+
+    int is_in(Point const& p, NT tol = NT(0)) const
+    {
+        return ((multiply(p.getCoefficients()) - _b).maxCoeff() <= tol) ? -1 : 0;
+    }
+
+    std::pair<Point, NT> ComputeInnerBall() const
+    {
+        HPolytope<Point> P(_d, get_mat(), _b);
+        return P.ComputeInnerBall();
+    }
+
+    // distances along v from r to the boundary, (positive, negative)
+    std::pair<NT, NT> line_intersect(Point const& r, Point const& v) const
+    {
+        VT Ar, Av;
+        return line_intersect(r, v, Ar, Av);
+    }
+
+    // as above, and stores A r and A v; with pos the second entry is the
+    // facet that is hit
+    std::pair<NT, NT> line_intersect(Point const& r, Point const& v, VT &Ar, VT &Av,
+                                     bool pos = false) const
+    {
+        Ar = multiply(r.getCoefficients());
+        Av = multiply(v.getCoefficients());
+        return chord(Ar, Av, pos);
+    }
+
+    // as above for r = r_prev + lambda_prev v_prev, given A r_prev and A v_prev
+    // in Ar and Av, so only A v is computed
+    std::pair<NT, NT> line_intersect(Point const&, Point const& v, VT &Ar, VT &Av,
+                                     NT const& lambda_prev, bool pos = false) const
+    {
+        Ar.noalias() += lambda_prev * Av;
+        Av = multiply(v.getCoefficients());
+        return chord(Ar, Av, pos);
+    }
+
+    // distance along v from r to the boundary and the facet that is hit
+    std::pair<NT, int> line_positive_intersect(Point const& r, Point const& v) const
+    {
+        VT Ar, Av;
+        return line_positive_intersect(r, v, Ar, Av);
+    }
+
+    std::pair<NT, int> line_positive_intersect(Point const& r, Point const& v, VT &Ar, VT &Av) const
+    {
+        std::pair<NT, NT> res = line_intersect(r, v, Ar, Av, true);
+        return std::make_pair(res.first, int(res.second));
+    }
+
+    std::pair<NT, int> line_positive_intersect(Point const& r, Point const& v, VT &Ar, VT &Av,
+                                               NT const& lambda_prev) const
+    {
+        std::pair<NT, NT> res = line_intersect(r, v, Ar, Av, lambda_prev, true);
+        return std::make_pair(res.first, int(res.second));
+    }
+
+    // first step of a billiard trajectory: stores A r and A v, and the facet
+    // that is hit with the inner product of v and its row in params
+    template <typename update_parameters>
+    std::pair<NT, int> line_first_positive_intersect(Point const& r, Point const& v, VT &Ar, VT &Av,
+                                                     update_parameters &params) const
+    {
+        std::pair<NT, int> res = line_positive_intersect(r, v, Ar, Av);
+        params.facet_prev = res.second;
+        params.inner_vi_ak = Av(res.second);
+        return res;
+    }
+
+    // chord along the coordinate axis rand_coord through r; stores the slack
+    // b - A T r in lamdas
+    std::pair<NT, NT> line_intersect_coord(Point const& r, unsigned int const& rand_coord, VT &lamdas) const
+    {
+        lamdas = _b - multiply(r.getCoefficients());
+        return coord_chord(lamdas, rand_coord);
+    }
+
+    // as above when r differs from r_prev, whose slack is in lamdas, only in
+    // the coordinate rand_coord_prev
+    std::pair<NT, NT> line_intersect_coord(Point const& r, Point const& r_prev,
+                                           unsigned int const& rand_coord,
+                                           unsigned int const& rand_coord_prev,
+                                           NT const&, VT &lamdas) const
+    {
+        return line_intersect_coord(rand_coord, rand_coord_prev,
+                                    r[rand_coord_prev] - r_prev[rand_coord_prev], lamdas);
+    }
+
+    // as above given the step along rand_coord_prev instead of the two points;
+    // only the nonzeros of two columns of A T are visited
+    std::pair<NT, NT> line_intersect_coord(unsigned int const& rand_coord,
+                                           unsigned int const& rand_coord_prev,
+                                           NT const& step_prev, VT &lamdas) const
+    {
+        update_slack(rand_coord_prev, step_prev, lamdas);
+        return coord_chord(lamdas, rand_coord);
+    }
+
+    // lamdas -> lamdas - step * (column coord of A T), the slack after a step
+    // along the coordinate axis coord
+    void update_slack(unsigned int const& coord, NT const& step, VT &lamdas) const
+    {
+        if (step == NT(0)) return;
+        if (!_transformed)
+        {
+            for (typename SpMT::InnerIterator it(_A, coord); it; ++it)
+            {
+                lamdas(it.row()) -= step * it.value();
+            }
+            return;
+        }
+        SpVT a = column(coord);
+        for (typename SpVT::InnerIterator it(a); it; ++it)
+        {
+            lamdas(it.index()) -= step * it.value();
+        }
+    }
+
+    void compute_reflection(Point &v, Point const&, int const& facet) const
+    {
+        VT a = row(facet);
+        v += Point(VT((NT(-2) * v.getCoefficients().dot(a) / a.squaredNorm()) * a));
+    }
+
+    // reflection on params.facet_prev, whose inner product with v is
+    // params.inner_vi_ak
+    template <typename update_parameters>
+    void compute_reflection(Point &v, Point const&, update_parameters const& params) const
+    {
+        VT a = row(params.facet_prev);
+        v += Point(VT((NT(-2) * params.inner_vi_ak / a.squaredNorm()) * a));
+    }
+
+    // x -> T x
+    void linear_transformIt(MT const& T)
+    {
+        SpMT T_sparse = T.sparseView();
+        _T = _transformed ? SpMT(_T * T_sparse) : T_sparse;
+        _T.makeCompressed();
+        _transformed = true;
+
+        SpMT AT = SpMT(_A * _T).pruned();
+        if (AT.nonZeros() <= _A.nonZeros() + _T.nonZeros())
+        {
+            _A = AT;
+            _A.makeCompressed();
+            _A_rows = _A;
+            _A_rows.makeCompressed();
+            _T = SpMT();
+            _transformed = false;
+        }
+    }
+
+    // x -> x + e
+    void shift(VT const& e)
+    {
+        _b -= multiply(e);
+    }
+
+    void normalize()
+    {
+        VT row_norms(_A_rows.rows());
+        for (unsigned int i = 0; i < _A_rows.rows(); i++)
+        {
+            row_norms(i) = row(i).norm();
+        }
+        VT inv_norms = row_norms.cwiseInverse();
+        _A = inv_norms.asDiagonal() * _A;
+        _A_rows = inv_norms.asDiagonal() * _A_rows;
+        _b = _b.cwiseProduct(inv_norms);
+    }
+
+private:
+    // (lambda_plus, lambda_minus) of the chord given A r and A v; with pos,
+    // (lambda_plus, facet of lambda_plus)
+    std::pair<NT, NT> chord(VT const& Ar, VT const& Av, bool pos) const
+    {
+        const NT inf = std::numeric_limits<NT>::max();
+        VT ratios = (_b - Ar).cwiseQuotient(Av);
+        int facet;
+        NT lambda_plus = (Av.array() > NT(0)).select(ratios.array(), inf).minCoeff(&facet);
+        if (pos) return std::make_pair(lambda_plus, NT(facet));
+        NT lambda_minus = (Av.array() < NT(0)).select(ratios.array(), -inf).maxCoeff();
+        return std::make_pair(lambda_plus, lambda_minus);
+    }
+
+    std::pair<NT, NT> coord_chord(VT const& lamdas, unsigned int const& rand_coord) const
+    {
+        const NT inf = std::numeric_limits<NT>::max();
+        NT lambda_plus = inf, lambda_minus = -inf;
+
+        if (!_transformed)
+        {
+            for (typename SpMT::InnerIterator it(_A, rand_coord); it; ++it)
+            {
+                NT ratio = lamdas(it.row()) / it.value();
+                if (it.value() > NT(0)) lambda_plus = std::min(lambda_plus, ratio);
+                else lambda_minus = std::max(lambda_minus, ratio);
+            }
+        }
+        else
+        {
+            SpVT a = column(rand_coord);
+            for (typename SpVT::InnerIterator it(a); it; ++it)
+            {
+                NT ratio = lamdas(it.index()) / it.value();
+                if (it.value() > NT(0)) lambda_plus = std::min(lambda_plus, ratio);
+                else if (it.value() < NT(0)) lambda_minus = std::max(lambda_minus, ratio);
+            }
+        }
+        return std::make_pair(lambda_plus, lambda_minus);
+    }
+
+    unsigned int _d;
+    SpMT _A;
+    RowSpMT _A_rows;
+    VT _b;
+    SpMT _T;
+    bool _transformed;
+};
+
+
+// Coordinate directions hit-and-run on a SparseHPolytope. The walk caches the
+// slack vector b - A x and uses the compressed columns of the polytope, so a
+// step along coordinate i only visits the nonzeros of the i-th column of A
+// (of A T if the polytope keeps a transform), both to compute the chord and
+// to update the cache.
+template <typename Polytope, typename RandomNumberGenerator>
+struct SparseCDHRWalk
+{
+    typedef typename Polytope::NT NT;
+    typedef typename Polytope::VT VT;
+
+    SparseCDHRWalk(Polytope const& P, VT const& x0)
+        : _P(P), x(x0), _coord_prev(0), _step_prev(0)
+    {
+        _lamdas = P.get_vec() - P.multiply(x);
+    }
+
+    void apply(unsigned int const& walk_length,
+               RandomNumberGenerator &rng)
+    {
+        for (unsigned int j = 0u; j < walk_length; ++j)
+        {
+            unsigned int coord = rng.sample_uidist();
+            std::pair<NT, NT> bpair = _P.line_intersect_coord(coord, _coord_prev, _step_prev, _lamdas);
+
+            NT t = bpair.second + rng.sample_urdist() * (bpair.first - bpair.second);
+            x(coord) += t;
+            _coord_prev = coord;
+            _step_prev = t;
+        }
+    }
+
+    // b - A x, including the last step, which is applied to the cache only
+    // at the start of the next one
+    VT slack() const
+    {
+        VT lamdas = _lamdas;
+        _P.update_slack(_coord_prev, _step_prev, lamdas);
+        return lamdas;
+    }
+
+    Polytope const& _P;
+    VT x;
+    VT _lamdas;
+    unsigned int _coord_prev;
+    NT _step_prev;
+};
+
+
+template <typename Polytope, typename NT>
+Polytope read_polytope(std::string filename) {
+    std::ifstream inp;
+    std::vector<std::vector<NT> > Pin;
+    inp.open(filename,std::ifstream::in);
+    read_pointset(inp, Pin);
+    Polytope P(Pin);
+    return P;
+}
+
+inline bool exists_check (const std::string& name) {
+    std::ifstream f(name.c_str());
+    return f.good();
+}
+
+
+template <typename NT>
+void call_test_sparse_cdhr(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef SparseHPolytope<Point> SparseHpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 10, walkL = 10, numpoints = 10000;
+
+    std::cout << "--- Testing sparse CDHR on H-cube10" << std::endl;
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    SparseHpolytope Q(P);
+    RNGType rng(d);
+
+    SparseCDHRWalk<SparseHpolytope, RNGType> walk(Q, VT::Zero(d));
+    MT samples(d, numpoints);
+
+    for (unsigned int i = 0; i < numpoints; i++)
+    {
+        walk.apply(walkL, rng);
+        samples.col(i) = walk.x;
+    }
+
+    // the cached slack must agree with the one computed from scratch
+    VT slack = P.get_vec() - P.get_mat() * walk.x;
+    std::cout << "slack drift = " << (slack - walk.slack()).norm() << std::endl;
+    CHECK((slack - walk.slack()).norm() < 1e-8);
+
+    VT score = univariate_psrf<NT, VT>(samples);
+    std::cout << "psrf = " << score.maxCoeff() << std::endl;
+    CHECK(score.maxCoeff() < 1.1);
+}
+
+template <typename NT>
+void call_test_benchmark_sparse_cdhr(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef SparseHPolytope<Point> SparseHpolytope;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    std::vector<std::string> names{"e_coli", "recon2"};
+    unsigned int num_steps = 100000;
+
+    for (std::string name : names) {
+        std::string filename = "metabolic_full_dim/polytope_" + name + ".ine";
+        if (!exists_check(filename)) continue;
+
+        Hpolytope P = read_polytope<Hpolytope, NT>(filename);
+        P.normalize();
+        std::pair<Point, NT> inner_ball = P.ComputeInnerBall();
+        unsigned int d = P.dimension();
+        RNGType rng(d);
+
+        std::cout << "--- Benchmark CDHR on " << name << " (d = " << d
+                  << ", m = " << P.num_of_hyperplanes() << ")" << std::endl;
+
+        Point p = inner_ball.first;
+        CDHRWalk::Walk<Hpolytope, RNGType> dense_walk(P, p, rng);
+        auto start = std::chrono::high_resolution_clock::now();
+        dense_walk.apply(P, p, num_steps, rng);
+        auto stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Dense CDHR, time per step (us): "
+                  << NT(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / num_steps
+                  << std::endl;
+
+        SparseHpolytope Q(P);
+        SparseCDHRWalk<SparseHpolytope, RNGType> sparse_walk(Q, inner_ball.first.getCoefficients());
+        start = std::chrono::high_resolution_clock::now();
+        sparse_walk.apply(num_steps, rng);
+        stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Sparse CDHR, time per step (us): "
+                  << NT(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / num_steps
+                  << std::endl;
+        std::cout << "nonzeros of A: " << Q.get_sparse_mat().nonZeros() << std::endl;
+
+        CHECK(P.is_in(Point(sparse_walk.x)) == -1);
+    }
+}
+
+
+// the reflection state of a billiard trajectory that line_first_positive_intersect
+// fills in
+template <typename NT>
+struct reflection_parameters
+{
+    int facet_prev = 0;
+    NT inner_vi_ak = NT(0);
+};
+
+template <typename NT>
+void call_test_sparse_hpolytope_oracles(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef SparseHPolytope<Point> SparseHpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 10, num_queries = 100;
+
+    std::cout << "--- Testing sparse H-polytope oracles on H-skinny_cube10" << std::endl;
+    Hpolytope P = generate_skinny_cube<Hpolytope>(d, false);
+    P.normalize();
+    SparseHpolytope Q(P);
+    RNGType rng(d);
+
+    std::pair<Point, NT> inner_ball = P.ComputeInnerBall();
+    std::pair<Point, NT> sparse_inner_ball = Q.ComputeInnerBall();
+    CHECK(std::abs(inner_ball.second - sparse_inner_ball.second) < 1e-8);
+
+    for (unsigned int round = 0; round < 2; round++)
+    {
+        if (round == 1)
+        {
+            // apply the same affine map to both
+            MT T = MT::Identity(d, d) + NT(0.1) * MT::Random(d, d);
+            VT shift = NT(0.1) * VT::Random(d);
+            P.shift(shift);
+            P.linear_transformIt(T);
+            Q.shift(shift);
+            Q.linear_transformIt(T);
+        }
+        CHECK((P.get_mat() - Q.get_mat()).norm() < 1e-10);
+        CHECK((P.get_vec() - Q.get_vec()).norm() < 1e-10);
+
+        Point r = P.ComputeInnerBall().first;
+        for (unsigned int i = 0; i < num_queries; i++)
+        {
+            VT direction(d);
+            for (unsigned int j = 0; j < d; j++) direction(j) = rng.sample_ndist();
+            Point v(direction);
+
+            std::pair<NT, NT> dense_pair = P.line_intersect(r, v);
+            std::pair<NT, NT> sparse_pair = Q.line_intersect(r, v);
+            CHECK(std::abs(dense_pair.first - sparse_pair.first) < 1e-10);
+            CHECK(std::abs(dense_pair.second - sparse_pair.second) < 1e-10);
+
+            std::pair<NT, int> hit = Q.line_positive_intersect(r, v);
+            CHECK(std::abs(hit.first - sparse_pair.first) < 1e-10);
+
+            // the overloads that cache A r and A v: a second chord from
+            // r + lambda v reuses them
+            VT Ar, Av;
+            std::pair<NT, NT> cached_pair = Q.line_intersect(r, v, Ar, Av);
+            CHECK(std::abs(cached_pair.first - sparse_pair.first) < 1e-10);
+            CHECK((Ar - P.get_mat() * r.getCoefficients()).norm() < 1e-10);
+            CHECK((Av - P.get_mat() * direction).norm() < 1e-10);
+
+            NT lambda = NT(0.5) * cached_pair.first;
+            Point r_next(VT(r.getCoefficients() + lambda * direction));
+            VT direction_next(d);
+            for (unsigned int j = 0; j < d; j++) direction_next(j) = rng.sample_ndist();
+            Point v_next(direction_next);
+            std::pair<NT, NT> next_pair = Q.line_intersect(r_next, v_next, Ar, Av, lambda);
+            std::pair<NT, NT> dense_next_pair = P.line_intersect(r_next, v_next);
+            CHECK(std::abs(next_pair.first - dense_next_pair.first) < 1e-10);
+            CHECK(std::abs(next_pair.second - dense_next_pair.second) < 1e-10);
+
+            reflection_parameters<NT> params;
+            std::pair<NT, int> first_hit = Q.line_first_positive_intersect(r, v, Ar, Av, params);
+            CHECK(first_hit.second == hit.second);
+            CHECK(params.facet_prev == hit.second);
+            CHECK(std::abs(params.inner_vi_ak - Q.row(hit.second).dot(direction)) < 1e-10);
+
+            // coordinate chords, the first one from scratch and the next one
+            // from the cached slack after a step along the first axis
+            unsigned int coord = i % d, next_coord = (i + 1) % d;
+            VT lamdas;
+            std::pair<NT, NT> coord_pair = Q.line_intersect_coord(r, coord, lamdas);
+            std::pair<NT, NT> axis_pair = Q.line_intersect(r, Point(VT(VT::Unit(d, coord))));
+            CHECK(std::abs(coord_pair.first - axis_pair.first) < 1e-10);
+            CHECK(std::abs(coord_pair.second - axis_pair.second) < 1e-10);
+
+            NT step = NT(0.5) * coord_pair.first;
+            Point r_coord(VT(r.getCoefficients() + step * VT::Unit(d, coord)));
+            std::pair<NT, NT> next_coord_pair = Q.line_intersect_coord(r_coord, r, next_coord, coord,
+                                                                       NT(0), lamdas);
+            axis_pair = Q.line_intersect(r_coord, Point(VT(VT::Unit(d, next_coord))));
+            CHECK(std::abs(next_coord_pair.first - axis_pair.first) < 1e-10);
+            CHECK(std::abs(next_coord_pair.second - axis_pair.second) < 1e-10);
+            CHECK((lamdas - (Q.get_vec() - Q.multiply(r_coord.getCoefficients()))).norm() < 1e-10);
+
+            // the reflected direction keeps its norm and flips the normal component
+            Point w = v;
+            Q.compute_reflection(w, r, hit.second);
+            VT a = Q.get_mat().row(hit.second).transpose();
+            CHECK(std::abs(w.getCoefficients().norm() - direction.norm()) < 1e-10);
+            CHECK(std::abs(w.getCoefficients().dot(a) + direction.dot(a)) < 1e-10);
+
+            Point u = v;
+            Q.compute_reflection(u, r, params);
+            CHECK((u.getCoefficients() - w.getCoefficients()).norm() < 1e-10);
+        }
+    }
+
+    // a diagonal transform is folded into the sparse A and no T is kept
+    SparseHpolytope S(generate_skinny_cube<Hpolytope>(d, false));
+    std::size_t bytes = S.memory_bytes();
+    MT diagonal = VT::LinSpaced(d, NT(1), NT(2)).asDiagonal();
+    S.linear_transformIt(diagonal);
+    CHECK(!S.has_transform());
+    CHECK(S.memory_bytes() == bytes);
+    CHECK((S.get_mat() - generate_skinny_cube<Hpolytope>(d, false).get_mat() * diagonal).norm() < 1e-12);
+}
+
+// Times line_intersect on P and on its sparse copy Q, and the query points
+template <typename Polytope, typename SparsePolytope, typename Point>
+void time_line_intersect(Polytope const& P, SparsePolytope const& Q, Point const& r,
+                         std::vector<Point> const& directions)
+{
+    typedef typename Polytope::NT NT;
+
+    NT sum = NT(0);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (Point const& v : directions) sum += P.line_intersect(r, v).first;
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "Dense line_intersect, time per call (us): "
+              << NT(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / directions.size()
+              << std::endl;
+
+    NT sparse_sum = NT(0);
+    start = std::chrono::high_resolution_clock::now();
+    for (Point const& v : directions) sparse_sum += Q.line_intersect(r, v).first;
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "Sparse line_intersect, time per call (us): "
+              << NT(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / directions.size()
+              << std::endl;
+
+    CHECK(std::abs(sum - sparse_sum) < 1e-8 * std::abs(sum));
+}
+
+// Memory and line_intersect time of the sparse H-polytope against the dense
+// one, before and after svd_rounding. The rounding transform is dense, so
+// after rounding the sparse polytope keeps A sparse and T apart.
+template <typename NT>
+void call_test_benchmark_sparse_hpolytope(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef SparseHPolytope<Point> SparseHpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    std::vector<std::string> names{"e_coli", "recon2"};
+    unsigned int num_queries = 1000, num_steps = 100000;
+
+    for (std::string name : names) {
+        std::string filename = "metabolic_full_dim/polytope_" + name + ".ine";
+        if (!exists_check(filename)) continue;
+
+        Hpolytope P = read_polytope<Hpolytope, NT>(filename);
+        P.normalize();
+        SparseHpolytope Q(P);
+        unsigned int d = P.dimension();
+        RNGType rng(d);
+
+        std::size_t dense_bytes = sizeof(NT) * (P.get_mat().size() + P.get_vec().size());
+        std::cout << "--- Benchmark sparse H-polytope on " << name << " (d = " << d
+                  << ", m = " << P.num_of_hyperplanes() << ")" << std::endl;
+        std::cout << "memory dense (MB): " << NT(dense_bytes) / (1 << 20)
+                  << ", sparse (MB): " << NT(Q.memory_bytes()) / (1 << 20) << std::endl;
+
+        std::vector<Point> directions;
+        for (unsigned int i = 0; i < num_queries; i++) {
+            VT direction(d);
+            for (unsigned int j = 0; j < d; j++) direction(j) = rng.sample_ndist();
+            directions.push_back(Point(direction));
+        }
+
+        std::pair<Point, NT> inner_ball = P.ComputeInnerBall();
+        time_line_intersect(P, Q, inner_ball.first, directions);
+
+        std::tuple<MT, VT, NT> res = svd_rounding<AcceleratedBilliardWalk, MT, VT>(P, inner_ball, 1, rng);
+        // svd_rounding leaves the rows of P normalized
+        Q.shift(std::get<1>(res));
+        Q.linear_transformIt(std::get<0>(res));
+        Q.normalize();
+        CHECK((P.get_mat() - Q.get_mat()).norm() < 1e-8 * P.get_mat().norm());
+        CHECK((P.get_vec() - Q.get_vec()).norm() < 1e-8 * P.get_vec().norm());
+
+        std::cout << "after rounding, memory dense (MB): " << NT(dense_bytes) / (1 << 20)
+                  << ", sparse (MB): " << NT(Q.memory_bytes()) / (1 << 20)
+                  << (Q.has_transform() ? " (A and T)" : " (A T)") << std::endl;
+
+        inner_ball = P.ComputeInnerBall();
+        time_line_intersect(P, Q, inner_ball.first, directions);
+
+        Point p = inner_ball.first;
+        CDHRWalk::Walk<Hpolytope, RNGType> dense_walk(P, p, rng);
+        auto start = std::chrono::high_resolution_clock::now();
+        dense_walk.apply(P, p, num_steps, rng);
+        auto stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Dense CDHR after rounding, time per step (us): "
+                  << NT(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / num_steps
+                  << std::endl;
+
+        SparseCDHRWalk<SparseHpolytope, RNGType> sparse_walk(Q, inner_ball.first.getCoefficients());
+        start = std::chrono::high_resolution_clock::now();
+        sparse_walk.apply(num_steps, rng);
+        stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Sparse CDHR after rounding, time per step (us): "
+                  << NT(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / num_steps
+                  << std::endl;
+
+        CHECK(P.is_in(Point(sparse_walk.x)) == -1);
+    }
+}
+
+
+TEST_CASE("sparse_cdhr") {
+    call_test_sparse_cdhr<double>();
+}
+
+TEST_CASE("benchmark_sparse_cdhr") {
+    call_test_benchmark_sparse_cdhr<double>();
+}
+
+TEST_CASE("sparse_hpolytope_oracles") {
+    call_test_sparse_hpolytope_oracles<double>();
+}
+
+TEST_CASE("benchmark_sparse_hpolytope") {
+    call_test_benchmark_sparse_hpolytope<double>();
+}
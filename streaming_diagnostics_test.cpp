@@ -0,0 +1,516 @@
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include "doctest.h"
+#include "diagnostics/diagnostics.hpp"
+#include "diagnostics/univariate_psrf.hpp"
+#include "Eigen/Eigen"
+#include <iostream>
+#include <limits>
+#include <thread>
+#include "known_polytope_generators.h"
+#include "misc.h"
+#include "random.hpp"
+#include "random/uniform_int.hpp"
+#include "random/normal_distribution.hpp"
+#include "random/uniform_real_distribution.hpp"
+#include "random_walks/random_walks.hpp"
+#include <vector>
+
+
+// Effective sample size, split-PSRF and autocorrelations of a chain, updated
+// one draw at a time without keeping the draws. The chain is cut into batches
+// of equal size that keep their count, mean and sum of squared deviations.
+// When max_batches batches are complete, neighbouring batches are merged and
+// the batch size doubles, so the memory is O(d * max_batches) and an update
+// costs O(d) amortized. The ESS is computed by batch means and the PSRF from
+// the first and the second half of the batches. The autocovariances are
+// accumulated online at the lags 1, 2, 4, ..., max_lag from a ring buffer of
+// the last max_lag draws. Batch means are only trusted once the batches are
+// longer than the correlation of the chain, so until the batch size reaches
+// min_batch_size() the ESS is 0 and the PSRF is infinite.
+template <typename NT, typename VT>
+class streaming_diagnostics
+{
+    typedef Eigen::Matrix<NT, Eigen::Dynamic, Eigen::Dynamic> MT;
+
+    struct batch
+    {
+        unsigned long long n;
+        VT mean;
+        VT M2;
+
+        batch(unsigned int dim) : n(0), mean(VT::Zero(dim)), M2(VT::Zero(dim)) {}
+
+        void update(VT const& x)
+        {
+            n++;
+            VT delta = x - mean;
+            mean += delta / NT(n);
+            M2 += delta.cwiseProduct(x - mean);
+        }
+
+        // Chan et al. update for the union of two batches
+        void merge(batch const& other)
+        {
+            if (other.n == 0) return;
+            NT n_total = NT(n + other.n);
+            VT delta = other.mean - mean;
+            mean += delta * (NT(other.n) / n_total);
+            M2 += other.M2 + delta.cwiseAbs2() * (NT(n) * NT(other.n) / n_total);
+            n += other.n;
+        }
+
+        VT variance() const
+        {
+            return M2 / NT(n - 1);
+        }
+    };
+
+public:
+    streaming_diagnostics(unsigned int dim,
+                          unsigned int max_batches = 128,
+                          unsigned int max_lag = 64)
+        : _dim(dim), _max_batches(max_batches + max_batches % 2), _batch_size(1),
+          _current(dim), _total(dim), _window(MT::Zero(dim, max_lag)), _window_head(0)
+    {
+        for (unsigned int lag = 1; lag <= max_lag; lag *= 2)
+        {
+            _lags.push_back(lag);
+            _lagged_products.push_back(VT::Zero(dim));
+        }
+    }
+
+    void update(VT const& x)
+    {
+        unsigned long long n = _total.n;
+        unsigned int max_lag = _window.cols();
+        for (unsigned int j = 0; j < _lags.size(); j++)
+        {
+            if (n >= _lags[j])
+            {
+                _lagged_products[j] += x.cwiseProduct(_window.col((_window_head + max_lag - _lags[j]) % max_lag));
+            }
+        }
+        _window.col(_window_head) = x;
+        _window_head = (_window_head + 1) % max_lag;
+
+        _total.update(x);
+        _current.update(x);
+        if (_current.n == _batch_size)
+        {
+            _batches.push_back(_current);
+            _current = batch(_dim);
+            if (_batches.size() == _max_batches)
+            {
+                for (unsigned int i = 0; i < _max_batches / 2; i++)
+                {
+                    _batches[i] = _batches[2 * i];
+                    _batches[i].merge(_batches[2 * i + 1]);
+                }
+                _batches.resize(_max_batches / 2, batch(_dim));
+                _batch_size *= 2;
+            }
+        }
+    }
+
+    unsigned long long num_draws() const
+    {
+        return _total.n;
+    }
+
+    // Batch means estimate of the effective sample size of every coordinate
+    VT effective_sample_size() const
+    {
+        unsigned int a = _batches.size();
+        if (a < 2 || _batch_size < min_batch_size()) return VT::Zero(_dim);
+
+        batch means(_dim);
+        for (batch const& b : _batches) means.update(b.mean);
+
+        VT asymptotic_variance = NT(_batch_size) * means.variance();
+        return NT(_total.n) * _total.variance().cwiseQuotient(asymptotic_variance);
+    }
+
+    NT min_ess() const
+    {
+        return effective_sample_size().minCoeff();
+    }
+
+    // Potential scale reduction factor of every coordinate, computed from the
+    // first and the second half of the chain as two chains
+    VT psrf() const
+    {
+        unsigned int half = _batches.size() / 2;
+        if (half == 0 || _batch_size < min_batch_size())
+        {
+            return VT::Constant(_dim, std::numeric_limits<NT>::infinity());
+        }
+
+        batch first(_dim), second(_dim);
+        for (unsigned int i = 0; i < half; i++)
+        {
+            first.merge(_batches[i]);
+            second.merge(_batches[half + i]);
+        }
+
+        NT n = NT(first.n);
+        VT W = (first.variance() + second.variance()) / NT(2);
+        VT B = n * (first.mean - second.mean).cwiseAbs2() / NT(2);
+        VT var_plus = ((n - NT(1)) / n) * W + B / n;
+        return var_plus.cwiseQuotient(W).cwiseSqrt();
+    }
+
+    NT max_psrf() const
+    {
+        return psrf().maxCoeff();
+    }
+
+    // Autocorrelation of every coordinate at lag = lags()[j], NaN while there
+    // are no pairs of draws that far apart
+    VT autocorrelation(unsigned int j) const
+    {
+        if (_total.n <= _lags[j]) return VT::Constant(_dim, std::numeric_limits<NT>::quiet_NaN());
+        unsigned long long n_pairs = _total.n - _lags[j];
+        VT covariance = _lagged_products[j] / NT(n_pairs) - _total.mean.cwiseAbs2();
+        return covariance.cwiseQuotient(_total.M2 / NT(_total.n));
+    }
+
+    std::vector<unsigned int> const& lags() const
+    {
+        return _lags;
+    }
+
+    // Smallest batch size for which the batch means are trusted: the square
+    // root of the number of draws, and at least the largest lag at which some
+    // coordinate still has an autocorrelation above 0.05 (twice max_lag if
+    // max_lag is such a lag, or if there are not yet enough draws to tell)
+    unsigned long long min_batch_size() const
+    {
+        unsigned long long size = (unsigned long long) std::ceil(std::sqrt(NT(_total.n)));
+        for (unsigned int j = 0; j < _lags.size(); j++)
+        {
+            VT acf = autocorrelation(j);
+            if (acf.hasNaN() || (acf.array() > NT(0.05)).any())
+            {
+                unsigned long long lag = j + 1 < _lags.size() ? _lags[j] : 2 * _lags[j];
+                size = std::max(size, lag);
+            }
+        }
+        return size;
+    }
+
+    unsigned long long batch_size() const
+    {
+        return _batch_size;
+    }
+
+private:
+    unsigned int _dim;
+    unsigned int _max_batches;
+    unsigned long long _batch_size;
+    std::vector<batch> _batches;
+    batch _current;
+    batch _total;
+    MT _window;
+    unsigned int _window_head;
+    std::vector<unsigned int> _lags;
+    std::vector<VT> _lagged_products;
+};
+
+
+// In-place iterative radix-2 FFT, a.size() must be a power of two
+template <typename NT>
+void fft_radix2(std::vector<std::complex<NT>> &a, bool inverse)
+{
+    unsigned int n = a.size();
+    for (unsigned int i = 1, j = 0; i < n; i++)
+    {
+        unsigned int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+
+    for (unsigned int len = 2; len <= n; len <<= 1)
+    {
+        NT angle = NT(2) * M_PI / NT(len) * (inverse ? NT(1) : NT(-1));
+        std::complex<NT> wlen(std::cos(angle), std::sin(angle));
+        for (unsigned int i = 0; i < n; i += len)
+        {
+            std::complex<NT> w(1);
+            for (unsigned int k = 0; k < len / 2; k++)
+            {
+                std::complex<NT> u = a[i + k], v = a[i + k + len / 2] * w;
+                a[i + k] = u + v;
+                a[i + k + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
+
+    if (inverse)
+    {
+        for (std::complex<NT> &c : a) c /= NT(n);
+    }
+}
+
+// Autocorrelation of x at all the lags 0, ..., N-1 by zero padding to a power
+// of two no smaller than 2N, so that the circular correlation is the linear one
+template <typename NT, typename VT>
+void fft_autocorrelation(VT const& x, VT &rho, std::vector<std::complex<NT>> &buffer)
+{
+    unsigned int N = x.size(), M = 1;
+    while (M < 2 * N) M <<= 1;
+
+    NT mean = x.mean();
+    buffer.assign(M, std::complex<NT>(0));
+    for (unsigned int t = 0; t < N; t++) buffer[t] = x(t) - mean;
+
+    fft_radix2(buffer, false);
+    for (std::complex<NT> &c : buffer) c = std::norm(c);
+    fft_radix2(buffer, true);
+
+    rho.resize(N);
+    for (unsigned int t = 0; t < N; t++) rho(t) = buffer[t].real() / buffer[0].real();
+}
+
+// Effective sample size from the autocorrelations by Geyer's initial monotone
+// sequence: the sums of consecutive pairs of autocorrelations are summed while
+// positive and forced to be non-increasing
+template <typename NT, typename VT>
+NT geyer_ess(VT const& rho)
+{
+    unsigned int N = rho.size();
+    NT previous_pair = std::numeric_limits<NT>::max(), sum = NT(0);
+    for (unsigned int t = 0; t + 1 < N; t += 2)
+    {
+        NT pair = rho(t) + rho(t + 1);
+        if (pair <= NT(0)) break;
+        pair = std::min(pair, previous_pair);
+        sum += pair;
+        previous_pair = pair;
+    }
+    NT tau = NT(-1) + NT(2) * sum;
+    return NT(N) / std::max(tau, NT(1) / std::log10(NT(N)));
+}
+
+// Effective sample size of every coordinate of samples (d x N) with FFT
+// autocorrelations. The coordinates are spread over num_threads threads
+// (0 means one per hardware thread), each with its own FFT buffer.
+template <typename NT, typename VT, typename MT>
+VT fft_effective_sample_size(MT const& samples, unsigned int &min_ess, unsigned int num_threads = 0)
+{
+    unsigned int d = samples.rows();
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, d);
+
+    VT ess(d);
+    auto worker = [&](unsigned int k) {
+        std::vector<std::complex<NT>> buffer;
+        VT x, rho;
+        for (unsigned int i = k; i < d; i += num_threads)
+        {
+            x = samples.row(i).transpose();
+            fft_autocorrelation<NT, VT>(x, rho, buffer);
+            ess(i) = geyer_ess<NT, VT>(rho);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int k = 1; k < num_threads; k++) threads.emplace_back(worker, k);
+    worker(0);
+    for (std::thread &t : threads) t.join();
+
+    min_ess = (unsigned int) ess.minCoeff();
+    return ess;
+}
+
+
+template <typename NT>
+void call_test_streaming_ar1(){
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 5, N = 200000;
+    NT rho = NT(0.9);
+    RNGType rng(d);
+
+    std::cout << "--- Testing streaming diagnostics on an AR(1) chain, rho = " << rho << std::endl;
+
+    streaming_diagnostics<NT, VT> diagnostics(d);
+    VT x = VT::Zero(d);
+    for (unsigned int t = 0; t < N; t++)
+    {
+        for (unsigned int i = 0; i < d; i++)
+        {
+            x(i) = rho * x(i) + std::sqrt(NT(1) - rho * rho) * rng.sample_ndist();
+        }
+        diagnostics.update(x);
+    }
+
+    NT target_ess = NT(N) * (NT(1) - rho) / (NT(1) + rho);
+    VT ess = diagnostics.effective_sample_size();
+    std::cout << "batch size = " << diagnostics.batch_size() << std::endl;
+    std::cout << "ESS = " << ess.transpose() << ", target = " << target_ess << std::endl;
+    std::cout << "PSRF = " << diagnostics.psrf().transpose() << std::endl;
+
+    // batch means are noisy for a single coordinate, so check the average
+    CHECK(std::abs(ess.mean() - target_ess) / target_ess < 0.15);
+    CHECK((ess.array() - target_ess).abs().maxCoeff() / target_ess < 0.5);
+    CHECK(diagnostics.max_psrf() < 1.1);
+
+    for (unsigned int j = 0; j < diagnostics.lags().size(); j++)
+    {
+        NT target_acf = std::pow(rho, NT(diagnostics.lags()[j]));
+        VT acf = diagnostics.autocorrelation(j);
+        std::cout << "lag " << diagnostics.lags()[j] << ": autocorrelation = " << acf(0)
+                  << ", target = " << target_acf << std::endl;
+        CHECK((acf.array() - target_acf).abs().maxCoeff() < 0.05);
+    }
+}
+
+template <typename NT>
+void call_test_streaming_ar1_no_early_stop(){
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 5, check_every = 10, max_draws = 1000000;
+    NT rho = NT(0.99), target_ess = NT(50);
+    RNGType rng(d);
+
+    std::cout << "--- Sampling an AR(1) chain, rho = " << rho
+              << ", until min ESS >= " << target_ess << std::endl;
+
+    streaming_diagnostics<NT, VT> diagnostics(d);
+    VT x = VT::Zero(d);
+    do
+    {
+        for (unsigned int i = 0; i < check_every; i++)
+        {
+            for (unsigned int k = 0; k < d; k++)
+            {
+                x(k) = rho * x(k) + std::sqrt(NT(1) - rho * rho) * rng.sample_ndist();
+            }
+            diagnostics.update(x);
+        }
+        // while the batches hold single draws the chain is not trusted
+        if (diagnostics.batch_size() == 1)
+        {
+            CHECK(diagnostics.min_ess() == NT(0));
+            CHECK(diagnostics.max_psrf() == std::numeric_limits<NT>::infinity());
+        }
+    } while (diagnostics.min_ess() < target_ess && diagnostics.num_draws() < max_draws);
+
+    NT true_ess = NT(diagnostics.num_draws()) * (NT(1) - rho) / (NT(1) + rho);
+    std::cout << "draws = " << diagnostics.num_draws() << ", min ESS = " << diagnostics.min_ess()
+              << ", ESS of the AR(1) chain = " << true_ess
+              << ", batch size = " << diagnostics.batch_size() << std::endl;
+
+    CHECK(diagnostics.min_ess() >= target_ess);
+    CHECK(true_ess >= target_ess / NT(2));
+}
+
+template <typename NT>
+void call_test_streaming_cdhr_target_ess(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 100, walkL = 1, check_every = 1000, max_rounds = 1000;
+    NT target_ess = NT(1000);
+
+    std::cout << "--- Sampling H-cube100 with CDHR until min ESS >= " << target_ess << std::endl;
+
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    RNGType rng(d);
+    Point p(d);
+    CDHRWalk::Walk<Hpolytope, RNGType> walk(P, p, rng);
+    streaming_diagnostics<NT, VT> diagnostics(d);
+
+    unsigned int rounds = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    do
+    {
+        for (unsigned int i = 0; i < check_every; i++)
+        {
+            walk.apply(P, p, walkL, rng);
+            diagnostics.update(p.getCoefficients());
+        }
+        rounds++;
+    } while (diagnostics.min_ess() < target_ess && rounds < max_rounds);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    std::cout << "draws = " << diagnostics.num_draws() << ", min ESS = " << diagnostics.min_ess()
+              << ", max PSRF = " << diagnostics.max_psrf() << std::endl;
+    std::cout << "ETA (ms): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << std::endl;
+
+    CHECK(diagnostics.min_ess() >= target_ess);
+    CHECK(diagnostics.max_psrf() < 1.1);
+}
+
+
+template <typename NT>
+void call_test_fft_effective_sample_size(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef HPolytope<Point> Hpolytope;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,1> VT;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef BoostRandomNumberGenerator<boost::mt19937, NT, 3> RNGType;
+
+    unsigned int d = 100, N = 30000, walkL = 1;
+
+    std::cout << "--- Testing FFT effective sample size on CDHR samples of H-cube100" << std::endl;
+
+    Hpolytope P = generate_cube<Hpolytope>(d, false);
+    RNGType rng(d);
+    Point p(d);
+    CDHRWalk::Walk<Hpolytope, RNGType> walk(P, p, rng);
+    MT samples(d, N);
+    for (unsigned int i = 0; i < N; i++)
+    {
+        walk.apply(P, p, walkL, rng);
+        samples.col(i) = p.getCoefficients();
+    }
+
+    unsigned int min_ess = 0, fft_min_ess = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VT ess = effective_sample_size<NT, VT, MT>(samples, min_ess);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "effective_sample_size, ETA (ms): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    VT fft_ess = fft_effective_sample_size<NT, VT, MT>(samples, fft_min_ess);
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "fft_effective_sample_size, ETA (ms): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << std::endl;
+
+    std::cout << "min ESS = " << min_ess << ", FFT min ESS = " << fft_min_ess << std::endl;
+    std::cout << "max relative difference = "
+              << ((ess - fft_ess).cwiseAbs().cwiseQuotient(ess)).maxCoeff() << std::endl;
+
+    CHECK(((ess - fft_ess).cwiseAbs().cwiseQuotient(ess)).maxCoeff() < 0.05);
+}
+
+
+TEST_CASE("streaming_ar1") {
+    call_test_streaming_ar1<double>();
+}
+
+TEST_CASE("streaming_ar1_no_early_stop") {
+    call_test_streaming_ar1_no_early_stop<double>();
+}
+
+TEST_CASE("streaming_cdhr_target_ess") {
+    call_test_streaming_cdhr_target_ess<double>();
+}
+
+TEST_CASE("fft_effective_sample_size") {
+    call_test_fft_effective_sample_size<double>();
+}
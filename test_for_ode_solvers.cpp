@@ -5,6 +5,7 @@
 #include <functional>
 #include "generators/known_polytope_generators.h"
 #include <iostream>
+#include <limits>
 #include "ode_solvers.hpp"
 #include "random.hpp"
 #include "random/uniform_int.hpp"
@@ -84,6 +85,121 @@ void check_index_norm_ub(Solver &solver, int num_steps, int index, NT target, NT
 }
 
 
+// Leapfrog integrator for B trajectories of x'' = F(x) at once. The positions
+// and velocities are the columns of X and V (d x B) and the batched functor
+// returns F for all the columns in one call, F(X) -> d x B. When an H-polytope
+// is given the position update is truncated at the boundary and the velocity is
+// reflected, column by column: the chord lengths of all the columns come from
+// one product A * V and masked column-wise reductions, and only the columns
+// that hit a facet take part in the reflection. A, b and the squared row norms
+// of A are copied once, and A * X is kept up to date with the moves (it is
+// recomputed every refresh_period steps so that rounding errors do not build
+// up), so X must only be changed through step().
+template <typename MT, typename Polytope, typename BatchFunctor>
+struct BatchLeapfrogODESolver {
+  typedef typename MT::Scalar NT;
+  typedef Eigen::Matrix<NT, Eigen::Dynamic, 1> VT;
+
+  unsigned int dim;
+  NT eta;
+  NT t;
+  MT X;
+  MT V;
+  BatchFunctor F;
+  Polytope *P;
+
+  MT A;
+  VT b;
+  VT A_row_norms2;
+  MT AX;
+
+  unsigned long long num_reflections = 0;
+  unsigned long long num_steps = 0;
+  unsigned int max_reflections = 100;
+  unsigned int refresh_period = 64;
+
+  BatchLeapfrogODESolver(NT initial_time, NT step, MT const& initial_X, MT const& initial_V,
+                         BatchFunctor oracle, Polytope *boundary = NULL) :
+    dim(initial_X.rows()), eta(step), t(initial_time), X(initial_X), V(initial_V),
+    F(oracle), P(boundary) {
+    if (P != NULL) {
+      A = P->get_mat();
+      b = P->get_vec();
+      A_row_norms2 = A.rowwise().squaredNorm();
+      AX.noalias() = A * X;
+    }
+  }
+
+  void step() {
+    // v <- v + eta / 2 F(x)
+    V.noalias() += (eta / 2) * F(X);
+
+    // x <- x + eta v, with reflections at the boundary
+    if (P == NULL) {
+      X.noalias() += eta * V;
+    } else {
+      move_and_reflect();
+    }
+
+    // v <- v + eta / 2 F(x)
+    V.noalias() += (eta / 2) * F(X);
+
+    t += eta;
+    num_steps++;
+  }
+
+  void steps(int n) {
+    for (int i = 0; i < n; i++) step();
+  }
+
+  void move_and_reflect() {
+    const NT inf = std::numeric_limits<NT>::max();
+    unsigned int B = X.cols();
+
+    if (num_steps % refresh_period == 0) {
+      AX.noalias() = A * X;
+    }
+
+    MT AV, ratios;
+    VT tau = VT::Constant(B, eta), lambdas, dts(B);
+    Eigen::Array<bool, Eigen::Dynamic, 1> active = Eigen::Array<bool, Eigen::Dynamic, 1>::Constant(B, true);
+
+    for (unsigned int it = 0; it < max_reflections && active.any(); it++) {
+      AV.noalias() = A * V;
+      ratios = ((-AX).colwise() + b).cwiseQuotient(AV);
+      lambdas = (AV.array() > NT(0)).select(ratios.array(), inf).colwise().minCoeff().transpose();
+
+      dts = active.select(lambdas.cwiseMin(tau), NT(0));
+      active = active && (lambdas.array() < tau.array());
+      X.noalias() += V * dts.asDiagonal();
+      AX.noalias() += AV * dts.asDiagonal();
+      tau -= dts;
+
+      for (unsigned int k = 0; k < B; k++) {
+        if (!active(k)) continue;
+        // reflect the velocity on the facet that was hit
+        int facet;
+        (AV.col(k).array() > NT(0)).select(ratios.col(k).array(), inf).minCoeff(&facet);
+        V.col(k) -= (NT(2) * AV(facet, k) / A_row_norms2(facet)) * A.row(facet).transpose();
+        num_reflections++;
+      }
+    }
+  }
+
+};
+
+template <typename MT>
+struct BatchIsotropicQuadraticFunctor {
+  typedef typename MT::Scalar NT;
+  NT alpha;
+
+  BatchIsotropicQuadraticFunctor(NT alpha_ = NT(1)) : alpha(alpha_) {}
+
+  MT operator() (MT const& X) const {
+    return -alpha * X;
+  }
+};
+
 template <typename NT>
 void test_euler(){
     typedef Cartesian<NT>    Kernel;
@@ -293,6 +409,64 @@ void test_rk4_constrained(){
     check_norm(rk_solver, 1000, NT(1), 1e-2);
 }
 
+template <typename NT>
+void test_batch_leapfrog(){
+    typedef Cartesian<NT>    Kernel;
+    typedef typename Kernel::Point    Point;
+    typedef std::vector<Point> pts;
+    typedef HPolytope<Point>  Hpolytope;
+    typedef std::vector<Hpolytope*> bounds;
+    typedef Eigen::Matrix<NT,Eigen::Dynamic,Eigen::Dynamic> MT;
+    typedef IsotropicQuadraticFunctor::GradientFunctor<Point> func;
+    typedef BatchIsotropicQuadraticFunctor<MT> batch_func;
+    IsotropicQuadraticFunctor::parameters<NT> params;
+    params.order = 2;
+    func F(params);
+
+    unsigned int dim = 10, B = 64, num_steps = 1000;
+
+    MT X0 = MT::Zero(dim, B);
+    MT V0 = 0.5 * MT::Random(dim, B);
+
+    // B single trajectories against one batch
+    auto start = std::chrono::high_resolution_clock::now();
+    MT X_single(dim, B);
+    for (unsigned int k = 0; k < B; k++) {
+      Point x0(dim), v0(dim);
+      v0.set_coeffs(V0.col(k));
+      LeapfrogODESolver<Point, NT, Hpolytope, func> leapfrog_solver =
+        LeapfrogODESolver<Point, NT, Hpolytope, func>(0, 0.01, pts{x0, v0}, F, bounds{NULL, NULL});
+      leapfrog_solver.steps(num_steps, true);
+      X_single.col(k) = leapfrog_solver.xs[0].getCoefficients();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    long ETA_single = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    BatchLeapfrogODESolver<MT, Hpolytope, batch_func> batch_solver(0, 0.01, X0, V0, batch_func());
+    batch_solver.steps(num_steps);
+    stop = std::chrono::high_resolution_clock::now();
+    long ETA_batch = (long) std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    std::cout << "Dimensionality: " << dim << ", trajectories: " << B << std::endl;
+    std::cout << "ETA single (us): " << ETA_single << std::endl;
+    std::cout << "ETA batch (us): " << ETA_batch << std::endl;
+    std::cout << "Max deviation: " << (batch_solver.X - X_single).cwiseAbs().maxCoeff() << std::endl << std::endl;
+
+    CHECK((batch_solver.X - X_single).cwiseAbs().maxCoeff() < 1e-8);
+
+    // Solve in P x R with reflections on the boundary of the cube
+    Hpolytope P = generate_cube<Hpolytope>(dim, false);
+    BatchLeapfrogODESolver<MT, Hpolytope, batch_func> constrained_solver(0, 0.01, X0, 4 * V0, batch_func(), &P);
+    constrained_solver.steps(num_steps);
+
+    std::cout << "Reflections per step: "
+              << NT(constrained_solver.num_reflections) / (num_steps * B) << std::endl << std::endl;
+
+    CHECK(constrained_solver.num_reflections > 0);
+    CHECK(((P.get_mat() * constrained_solver.X).colwise() - P.get_vec()).maxCoeff() < 1e-8);
+}
+
 template <typename NT>
 void call_test_first_order() {
 
@@ -312,6 +486,9 @@ void call_test_second_order() {
   test_leapfrog<NT>();
   // test_euler_constrained<NT>();
   test_leapfrog_constrained<NT>();
+
+  std::cout << "--- Testing batched leapfrog" << std::endl;
+  test_batch_leapfrog<NT>();
 }
 
 TEST_CASE("first_order") {